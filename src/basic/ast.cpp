@@ -78,12 +78,16 @@ std::string DeclarationAST::toJson() {
 }
 
 std::string IfAST::toString() {
+  auto elsestr =
+      (elsestatement != nullptr) ? " " + elsestatement->toString() : "";
   return "(if " + condition->toString() + " " + thenstatement->toString() +
-         " " + elsestatement->toString() + ")";
+         elsestr + ")";
 }
 std::string IfAST::toJson() {
+  auto elsestr =
+      (elsestatement != nullptr) ? ", " + elsestatement->toJson() : "";
   return "['if' ," + condition->toJson() + ", " + thenstatement->toJson() +
-         ", " + elsestatement->toJson() + "]";
+         elsestr + "]";
 }
 
 std::string ForAST::toString() {
@@ -36,6 +36,10 @@ enum AST_ID {
 
 };
 
+// floating point semantics of a function, annotated as "fn f(x) fast {...}".
+// DEFAULT follows the global --fast-math option.
+enum class FPMODE { DEFAULT, FAST, STRICT };
+
 class AST;  // forward
 class OpAST;
 class NumberAST;
@@ -157,6 +161,8 @@ class OpAST : public AST {
 class NumberAST : public AST {
  public:
   double val;
+  // integral literals become Int when type inference finds int context.
+  types::Value type = types::Float();
   explicit NumberAST(double input) : AST(NUMBER), val(input) {}
   void accept(ASTVisitor& visitor) override { visitor.visit(*this); };
   double getVal() { return val; };
@@ -185,6 +191,8 @@ class SymbolAST : public AST {
 class LvarAST : public SymbolAST {
  public:
   types::Value type;
+  // constant parameter like "maxsize:c:float", specialized at compile time
+  bool isconst = false;
   explicit LvarAST(std::string input) : SymbolAST(input) {
     type = types::None();  // default type is Float
     id = LVAR;
@@ -248,6 +256,7 @@ class LambdaAST : public AST {
   types::Value type;
   bool isrecursive = false;
   bool hasself = false;
+  FPMODE fpmode = FPMODE::DEFAULT;
   LambdaAST(std::shared_ptr<ArgumentsAST> Args, AST_Ptr Body,
             types::Value type = types::None())
       : args(std::move(Args)), body(std::move(Body)), type(std::move(type)) {
@@ -28,7 +28,10 @@ std::string MIRblock::toString() {
 }
 
 std::string NumberInst::toString() {
-  return lv_name + " = " + std::to_string(val);
+  auto valstr = std::holds_alternative<types::Int>(type)
+                    ? std::to_string(static_cast<int64_t>(val))
+                    : std::to_string(val);
+  return lv_name + " = " + valstr;
 }
 std::string StringInst::toString() {
   return lv_name + " = " + val;
@@ -57,6 +60,9 @@ std::string FunInst::toString() {
   if (isrecursive) {
     s += "[rec]";
   }
+  if (fpmode != FPMODE::DEFAULT) {
+    s += (fpmode == FPMODE::FAST) ? "[fast]" : "[strict]";
+  }
   s += " " + join(args, " , ");
   if (!freevariables.empty()) {
     s += " fv{";
@@ -85,16 +91,26 @@ std::string MakeClosureInst::toString() {
 std::string FcallInst::toString() {
   std::string s;
   auto timestr = (time)?"@"+time.value():"";
-  return lv_name + " = app" + fcalltype_str[ftype] + " " + fname + " " +
-         join(args, " , ") + timestr;
+  auto tailstr = (istailcall) ? "[tail]" : "";
+  return lv_name + " = app" + fcalltype_str[ftype] + tailstr + " " + fname +
+         " " + join(args, " , ") + timestr;
 }
 
 std::string ArrayInst::toString() {
-  return lv_name + " = array " + name + " " + join(args, " , ");
+  auto elems = args.empty() ? "(" + std::to_string(size) + ")"
+                            : join(args, " , ");
+  return lv_name + " = array " + name + " " + elems;
 }
 
 std::string ArrayAccessInst::toString() {
-  return lv_name + " = arrayaccess " + name + " " + index;
+  auto findname = [](auto& table, auto val) {
+    return std::find_if(table.begin(), table.end(),
+                        [&](auto& p) { return p.second == val; })
+        ->first;
+  };
+  return lv_name + " = arrayaccess " + name + " " + index + " (" +
+         findname(interp_table, interp) + "," +
+         findname(boundary_table, boundary) + ")";
 }
 
 std::string IfInst::toString() {
@@ -102,6 +118,15 @@ std::string IfInst::toString() {
   s += lv_name + " = if " + cond + "\n";
   s += thenblock->toString();
   s += elseblock->toString();
+  if (isexpr) {
+    s += lv_name + " = phi " + thenval + " " + elseval;
+  }
+  return s;
+}
+std::string ForInst::toString() {
+  std::string s;
+  s += lv_name + " = for " + loopvar + " in " + count + "\n";
+  s += body->toString();
   return s;
 }
 std::string ReturnInst::toString() { return "return " + val; }
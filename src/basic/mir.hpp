@@ -15,6 +15,14 @@ enum FCALLTYPE { DIRECT, CLOSURE, EXTERNAL };
 static std::map<FCALLTYPE, std::string> fcalltype_str = {
     {DIRECT, ""}, {CLOSURE, "cls"}, {EXTERNAL, "ext"}};
 
+// interpolation and boundary handling of array access with float index.
+enum class INTERP { NONE, LINEAR, CUBIC };
+enum class BOUNDARY { CLAMP, WRAP };
+static std::map<std::string, INTERP> interp_table = {
+    {"none", INTERP::NONE}, {"linear", INTERP::LINEAR}, {"cubic", INTERP::CUBIC}};
+static std::map<std::string, BOUNDARY> boundary_table = {
+    {"clamp", BOUNDARY::CLAMP}, {"wrap", BOUNDARY::WRAP}};
+
 
 // struct uniquestr{
 //   std::string str;
@@ -42,8 +50,9 @@ struct MIRinstruction {  // base class for MIR instruction
 
 struct NumberInst : public MIRinstruction {
  public:
-  NumberInst(const std::string& lv, double val)
-      : MIRinstruction(lv, types::Float()), val(val) {}
+  NumberInst(const std::string& lv, double val,
+             types::Value type = types::Float())
+      : MIRinstruction(lv, std::move(type)), val(val) {}
   double val;
   std::string toString() override;
 };
@@ -89,8 +98,9 @@ struct OpInst : public MIRinstruction {
   std::string op;
   std::string lhs;
   std::string rhs;
-  OpInst(const std::string& lv, std::string op, std::string lhs, std::string rhs)
-      : MIRinstruction(lv, types::Float()),
+  OpInst(const std::string& lv, std::string op, std::string lhs, std::string rhs,
+         types::Value type = types::Float())
+      : MIRinstruction(lv, std::move(type)),
         op(std::move(op)),
         lhs(std::move(lhs)),
         rhs(std::move(rhs)){};
@@ -108,6 +118,8 @@ struct FunInst : public MIRinstruction {
   bool ccflag = false;                     // utility for closure conversion
   bool hasself;
   bool isrecursive;
+  bool hastailcall = false;  // contains self tail call to be made into loop
+  FPMODE fpmode = FPMODE::DEFAULT;
   explicit FunInst(const std::string& name, std::deque<std::string> newargs,
                    types::Value type = types::Void(),
                    bool isrecursive = false);
@@ -119,6 +131,7 @@ struct FcallInst : public MIRinstruction {
   std::deque<std::string> args;
   std::optional<std::string> time;
   FCALLTYPE ftype;
+  bool istailcall = false;  // self call in tail position, jumps to the entry
   FcallInst(const std::string& lv, std::string fname, std::deque<std::string> args,
             FCALLTYPE ftype = CLOSURE, types::Value type = types::Float(),
             std::optional<std::string> time=std::nullopt)
@@ -147,30 +160,60 @@ struct ArrayInst : public MIRinstruction {
   std::deque<std::string> args;
   ArrayInst(const std::string& lv, std::deque<std::string> args)
       : MIRinstruction(lv, types::Array(types::Float(), args.size())),
-        args(std::move(args)),size(0) {}
+        size(args.size()),
+        args(std::move(args)) {}
+  // zero-initialized array made by Array(size)
+  ArrayInst(const std::string& lv, int size)
+      : MIRinstruction(lv, types::Array(types::Float(), size)), size(size) {}
 
   std::string toString() override;
 };
 struct ArrayAccessInst : public MIRinstruction {
   std::string name;
   std::string index;
-  ArrayAccessInst(const std::string& lv,std::string  name, std::string index)
+  INTERP interp;
+  BOUNDARY boundary;
+  ArrayAccessInst(const std::string& lv, std::string name, std::string index,
+                  INTERP interp = INTERP::LINEAR,
+                  BOUNDARY boundary = BOUNDARY::CLAMP)
       : MIRinstruction(lv, types::Float()),
         name(std::move(name)),
-        index(std::move(index)) {}
+        index(std::move(index)),
+        interp(interp),
+        boundary(boundary) {}
   std::string toString() override;
 };
 struct IfInst : public MIRinstruction {
   std::string cond;
   std::shared_ptr<MIRblock> thenblock;
   std::shared_ptr<MIRblock> elseblock;
-  IfInst(const std::string& name, std::string cond)
-      : MIRinstruction(name, types::Void()), cond(std::move(cond)) {
+  bool isexpr;
+  // names of the values each branch results in, used only when isexpr.
+  std::string thenval;
+  std::string elseval;
+  IfInst(const std::string& name, std::string cond, bool isexpr = false)
+      : MIRinstruction(name, isexpr ? types::Value(types::Float())
+                                    : types::Value(types::Void())),
+        cond(std::move(cond)),
+        isexpr(isexpr) {
     thenblock = std::make_shared<MIRblock>(name + "$then");
     elseblock = std::make_shared<MIRblock>(name + "$else");
   }
   std::string toString() override;
 };
+// loop over an induction variable from 0 to count-1.
+struct ForInst : public MIRinstruction {
+  std::string loopvar;
+  std::string count;
+  std::shared_ptr<MIRblock> body;
+  ForInst(const std::string& name, std::string loopvar, std::string count)
+      : MIRinstruction(name, types::Void()),
+        loopvar(std::move(loopvar)),
+        count(std::move(count)) {
+    body = std::make_shared<MIRblock>(name + "$body");
+  }
+  std::string toString() override;
+};
 struct ReturnInst : public MIRinstruction {
   std::string val;
   ReturnInst(const std::string& name, std::string val,
@@ -181,7 +224,7 @@ struct ReturnInst : public MIRinstruction {
 using Instructions =
     std::variant<NumberInst, StringInst,AllocaInst, RefInst, AssignInst, OpInst,
                  FunInst, FcallInst, MakeClosureInst, ArrayInst,
-                 ArrayAccessInst, IfInst, ReturnInst>;
+                 ArrayAccessInst, IfInst, ForInst, ReturnInst>;
 
 class MIRblock : public std::enable_shared_from_this<MIRblock> {
  public:
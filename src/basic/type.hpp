@@ -43,7 +43,20 @@ inline bool operator!=(const PrimitiveType& t1, const PrimitiveType& t2) {
 struct None : PrimitiveType {};
 struct Void : PrimitiveType {};
 struct Float : PrimitiveType {};
+struct Int : PrimitiveType {};
 struct String : PrimitiveType {};
+// fixed-length vector of float, mapped to SIMD vector type.
+struct Vector : PrimitiveType {
+  Vector() = default;
+  explicit Vector(int size) : size(size) {}
+  int size = 4;
+};
+inline bool operator==(const Vector& t1, const Vector& t2) {
+  return t1.size == t2.size;
+}
+inline bool operator!=(const Vector& t1, const Vector& t2) {
+  return t1.size != t2.size;
+}
 
 // Intermediate Type for type inference.
 
@@ -61,7 +74,7 @@ struct Tuple;
 struct Alias;
 
 using Value =
-    std::variant<None, Void, Float, String, Rec_Wrap<Ref>, Rec_Wrap<TypeVar>,
+    std::variant<None, Void, Float, Int, Vector, String, Rec_Wrap<Ref>, Rec_Wrap<TypeVar>,
                  Rec_Wrap<Pointer>, Rec_Wrap<Function>, Rec_Wrap<Closure>,
                  Rec_Wrap<Array>, Rec_Wrap<Struct>, Rec_Wrap<Tuple>,
                   Rec_Wrap<Alias>>;
@@ -279,6 +292,10 @@ struct ToStringVisitor {
   }
   std::string operator()(Void) const { return "void"; }
   std::string operator()(Float) const { return "float"; }
+  std::string operator()(Int) const { return "int"; }
+  std::string operator()(const Vector& v) const {
+    return "float" + std::to_string(v.size);
+  }
   std::string operator()(String) const { return "string"; }
   std::string operator()(const Ref& r) const {
     return std::visit(*this, r.val) + "&";
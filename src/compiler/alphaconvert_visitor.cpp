@@ -8,16 +8,27 @@
 
 #include "basic/helper_functions.hpp"
 namespace mimium {
-AlphaConvertVisitor::AlphaConvertVisitor() : namecount(0), envcount(0) {
+AlphaConvertVisitor::AlphaConvertVisitor()
+    : namecount(0), envcount(0), listdepth(0) {
   init();
 }
 void AlphaConvertVisitor::init() {
   namecount = 0;
   envcount = 0;
+  listdepth = 0;
+  const_functions.clear();
+  specialized.clear();
+  specialized_defs.clear();
+  const_params.clear();
+  global_numbers.clear();
+  used_globals.clear();
   env.reset();
   env = std::make_shared<SymbolEnv>("root", nullptr);
 }
 
+const std::unordered_set<std::string> AlphaConvertVisitor::builtin_forms = {
+    "Array", "lookup", "delay", "history"};
+
 AlphaConvertVisitor::~AlphaConvertVisitor() = default;
 auto AlphaConvertVisitor::getResult() -> std::shared_ptr<ListAST> {
   return std::static_pointer_cast<ListAST>(res_stack.top());
@@ -28,15 +39,22 @@ auto AlphaConvertVisitor::createNewLVar(LvarAST& ast)
   std::string newname;
   if (env->isVariableSet(ast.getVal())) {
     newname = env->findVariable(ast.getVal());
-  } else {
-    newname = ast.getVal();
-    if (!env->isRoot()) {  // do not rename variables in global scope
-      newname += std::to_string(namecount++);
+    if (const_params.count(newname) > 0) {
+      throw std::logic_error("constant parameter \"" + ast.getVal() +
+                             "\" cannot be reassigned");
     }
+  } else {
+    // variables in global scope are not renamed except for builtin_forms
+    newname = env->isRoot() ? getGlobalName(ast.getVal())
+                            : ast.getVal() + std::to_string(namecount++);
     env->setVariableRaw(ast.getVal(), newname);  // register to map
   }
   return std::make_unique<LvarAST>(newname, ast.type);
 }
+std::string AlphaConvertVisitor::getGlobalName(const std::string& name) {
+  return builtin_forms.count(name) > 0 ? name + std::to_string(namecount++)
+                                       : name;
+}
 
 void AlphaConvertVisitor::visit(LvarAST& ast) {
   auto newast = createNewLVar(ast);
@@ -48,6 +66,11 @@ void AlphaConvertVisitor::visit(RvarAST& ast) {
 
   if (env->isVariableSet(ast.getVal())) {
     newname = env->findVariable(ast.getVal());
+    auto constant = const_params.find(newname);
+    if (constant != const_params.end()) {
+      res_stack.push(std::make_shared<NumberAST>(constant->second));
+      return;
+    }
   } else {
     newname = ast.getVal();
     Logger::debug_log("symbol " + ast.getVal() +
@@ -67,14 +90,65 @@ void AlphaConvertVisitor::visit(OpAST& ast) {
   auto newast = std::make_unique<OpAST>(ast.op, stackPopPtr(), stackPopPtr());
   res_stack.push(std::move(newast));
 }
-void AlphaConvertVisitor::visit(ListAST& ast) { listastvisit(ast); }
+void AlphaConvertVisitor::visit(ListAST& ast) {
+  if (listdepth++ > 0) {
+    listastvisit(ast);
+    listdepth--;
+    return;
+  }
+  // top level: specialized functions are placed before the statement which
+  // uses them at first.
+  auto newast = std::make_shared<ListAST>();
+  for (auto& elem : ast.getElements()) {
+    elem->accept(*this);
+    auto res = stackPopPtr();
+    for (auto& def : specialized_defs) {
+      newast->appendAST(std::move(def));
+    }
+    specialized_defs.clear();
+    if (res != nullptr) {  // definition of function with constant parameters
+      newast->appendAST(std::move(res));
+    }
+  }
+  res_stack.push(std::move(newast));
+  listdepth--;
+}
 void AlphaConvertVisitor::visit(NumberAST& ast) { defaultvisit(ast); }
 void AlphaConvertVisitor::visit(StringAST& ast) { defaultvisit(ast); }
 
 void AlphaConvertVisitor::visit(AssignAST& ast) {
+  auto name = ast.getName()->getVal();
+  auto body = ast.getBody();
+  if (body->getid() == LAMBDA &&
+      hasConstParam(*std::static_pointer_cast<LambdaAST>(body))) {
+    if (!env->isRoot() || listdepth != 1) {
+      throw std::logic_error("function " + name +
+                             " with constant parameters must be defined in "
+                             "global scope");
+    }
+    auto newname = getGlobalName(name);
+    const_functions.insert_or_assign(newname,
+                                     std::static_pointer_cast<LambdaAST>(body));
+    env->setVariableRaw(name, newname);
+    res_stack.push(nullptr);
+    return;
+  }
+  bool isdefined = env->isVariableSet(name);
   ast.getName()->accept(*this);
   auto newname = std::static_pointer_cast<LvarAST>(stackPopPtr());
-  ast.getBody()->accept(*this);
+  auto resname = newname->getVal();
+  if (!isdefined && env->isRoot() && body->getid() == NUMBER) {
+    global_numbers.emplace(resname,
+                           std::static_pointer_cast<NumberAST>(body)->getVal());
+  } else if (isdefined && global_numbers.count(resname) > 0) {
+    if (used_globals.count(resname) > 0) {
+      throw std::logic_error(resname +
+                             " is used as a constant argument and cannot be "
+                             "reassigned");
+    }
+    global_numbers.erase(resname);
+  }
+  body->accept(*this);
   auto newast = std::make_unique<AssignAST>(std::move(newname), stackPopPtr());
   res_stack.push(std::move(newast));
 }
@@ -93,6 +167,15 @@ void AlphaConvertVisitor::visit(ArrayAccessAST& ast) {
   res_stack.push(std::move(newast));
 }
 void AlphaConvertVisitor::visit(FcallAST& ast) {
+  if (ast.getFname()->getid() == RVAR) {
+    auto fname = std::static_pointer_cast<RvarAST>(ast.getFname())->getVal();
+    // local variables shadowing it are renamed and not found
+    if (env->isVariableSet(fname) &&
+        const_functions.count(env->findVariable(fname)) > 0) {
+      res_stack.push(specializeCall(ast, env->findVariable(fname)));
+      return;
+    }
+  }
   ast.getFname()->accept(*this);
   auto newname = stackPopPtr();
   ast.getArgs()->accept(*this);
@@ -106,6 +189,125 @@ void AlphaConvertVisitor::visit(FcallAST& ast) {
       std::move(newname), std::move(newargs), std::move(newtime));
   res_stack.push(std::move(newast));
 }
+bool AlphaConvertVisitor::hasConstParam(LambdaAST& ast) {
+  auto& args = ast.getArgs()->getElements();
+  return std::any_of(args.begin(), args.end(),
+                     [](auto& a) { return a->isconst; });
+}
+// Operands of constant arguments are number literals, constant parameters and
+// globals assigned once with a number, combined with four arithmetic
+// operators.
+double AlphaConvertVisitor::evalConstArg(const AST_Ptr& arg,
+                                         const std::string& fname) {
+  switch (arg->getid()) {
+    case NUMBER:
+      return std::static_pointer_cast<NumberAST>(arg)->getVal();
+    case RVAR: {
+      auto name = std::static_pointer_cast<RvarAST>(arg)->getVal();
+      if (!env->isVariableSet(name)) {
+        break;
+      }
+      auto newname = env->findVariable(name);
+      auto param = const_params.find(newname);
+      if (param != const_params.end()) {
+        return param->second;
+      }
+      auto global = global_numbers.find(newname);
+      if (global != global_numbers.end()) {
+        used_globals.emplace(newname);
+        return global->second;
+      }
+      break;
+    }
+    case OP: {
+      auto op = std::static_pointer_cast<OpAST>(arg);
+      double lhs = evalConstArg(op->lhs, fname);
+      double rhs = evalConstArg(op->rhs, fname);
+      switch (op->getOpId()) {
+        case OP_ID::ADD:
+          return lhs + rhs;
+        case OP_ID::SUB:
+          return lhs - rhs;
+        case OP_ID::MUL:
+          return lhs * rhs;
+        case OP_ID::DIV:
+          return lhs / rhs;
+        default:
+          break;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  throw std::logic_error("argument for constant parameter of " + fname +
+                         " must be known at compile time");
+}
+AST_Ptr AlphaConvertVisitor::specializeCall(FcallAST& ast,
+                                            const std::string& fname) {
+  auto& params = const_functions.at(fname)->getArgs()->getElements();
+  auto& args = ast.getArgs()->getElements();
+  if (params.size() != args.size()) {
+    throw std::logic_error("number of arguments for " + fname +
+                           " is invalid");
+  }
+  std::vector<double> values;
+  auto newargs = std::make_shared<FcallArgsAST>();
+  auto param = params.begin();
+  for (auto& arg : args) {
+    if ((*param++)->isconst) {
+      values.push_back(evalConstArg(arg, fname));
+    } else {
+      arg->accept(*this);
+      newargs->appendAST(stackPopPtr());
+    }
+  }
+  std::shared_ptr<AST> newtime = nullptr;
+  if (ast.time != nullptr) {
+    ast.time->accept(*this);
+    newtime = stackPopPtr();
+  }
+  auto newfname = std::make_shared<RvarAST>(specialize(fname, values));
+  return std::make_shared<FcallAST>(std::move(newfname), std::move(newargs),
+                                    std::move(newtime));
+}
+std::string AlphaConvertVisitor::specialize(const std::string& fname,
+                                            const std::vector<double>& values) {
+  auto key = std::make_pair(fname, values);
+  auto it = specialized.find(key);
+  if (it != specialized.end()) {
+    return it->second;
+  }
+  auto newname = fname + "$c" + std::to_string(specialized.size());
+  specialized.emplace(key, newname);  // registered first for recursive call
+  auto& lambda = *const_functions.at(fname);
+  auto tmpenv = env;
+  while (!env->isRoot()) {
+    env = env->getParent();
+  }
+  env = env->createNewChild("lambda" + std::to_string(envcount));
+  envcount++;
+  auto newargs = std::make_shared<ArgumentsAST>();
+  auto value = values.begin();
+  for (auto& param : lambda.getArgs()->getElements()) {
+    if (param->isconst) {
+      auto paramname = param->getVal() + std::to_string(namecount++);
+      env->setVariableRaw(param->getVal(), paramname);
+      const_params.emplace(paramname, *value++);
+    } else {
+      newargs->appendAST(createNewLVar(*param));
+    }
+  }
+  lambda.getBody()->accept(*this);
+  auto newlambda =
+      std::make_shared<LambdaAST>(std::move(newargs), stackPopPtr(), lambda.type);
+  newlambda->isrecursive = lambda.isrecursive;
+  newlambda->fpmode = lambda.fpmode;
+  specialized_defs.push_back(std::make_shared<AssignAST>(
+      std::make_shared<LvarAST>(newname), std::move(newlambda)));
+  env = tmpenv;
+  return newname;
+}
 void AlphaConvertVisitor::visit(LambdaAST& ast) {
   env = env->createNewChild("lambda" + std::to_string(envcount));
   envcount++;
@@ -116,6 +318,7 @@ void AlphaConvertVisitor::visit(LambdaAST& ast) {
   auto newast = std::make_unique<LambdaAST>(std::move(newargs),
                                             std::move(newbody), ast.type);
   newast->isrecursive = ast.isrecursive;
+  newast->fpmode = ast.fpmode;
   res_stack.push(std::move(newast));
   env = env->getParent();
 }
@@ -124,8 +327,11 @@ void AlphaConvertVisitor::visit(IfAST& ast) {
   auto newcond = stackPopPtr();
   ast.getThen()->accept(*this);
   auto newthen = stackPopPtr();
-  ast.getElse()->accept(*this);
-  auto newelse = stackPopPtr();
+  AST_Ptr newelse = nullptr;
+  if (ast.getElse() != nullptr) {
+    ast.getElse()->accept(*this);
+    newelse = stackPopPtr();
+  }
   auto newast = std::make_unique<IfAST>(std::move(newcond), std::move(newthen),
                                         std::move(newelse), ast.isexpr);
   res_stack.push(std::move(newast));
@@ -136,16 +342,16 @@ void AlphaConvertVisitor::visit(ReturnAST& ast) {
   res_stack.push(std::make_unique<ReturnAST>(stackPopPtr()));
 }
 void AlphaConvertVisitor::visit(ForAST& ast) {
+  ast.getIterator()->accept(*this);
+  auto newiter = stackPopPtr();
   env = env->createNewChild("forloop" + std::to_string(envcount));
   envcount++;
   ast.getVar()->accept(*this);
   auto newvar = stackPopPtr();
-  ast.getIterator()->accept(*this);
-  auto newiter = stackPopPtr();
   ast.getExpression()->accept(*this);
   auto newexpr = stackPopPtr();
-  auto newast = std::make_unique<IfAST>(std::move(newvar), std::move(newiter),
-                                        std::move(newexpr));
+  auto newast = std::make_unique<ForAST>(std::move(newvar), std::move(newiter),
+                                         std::move(newexpr));
   res_stack.push(std::move(newast));
   env = env->getParent();
 }
@@ -3,6 +3,9 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #pragma once
+#include <map>
+#include <unordered_set>
+
 #include "basic/ast.hpp"
 #include "basic/environment.hpp"
 
@@ -57,11 +60,34 @@ class AlphaConvertVisitor : public ASTVisitor {
   };
 
   auto createNewLVar(LvarAST& ast) -> std::unique_ptr<LvarAST>;
+  // Calls of these names are built in forms only while the names are unbound,
+  // as recognized by TypeInferVisitor. Global definitions of them are renamed
+  // so that their calls are not taken as the built in ones.
+  const static std::unordered_set<std::string> builtin_forms;
+  std::string getGlobalName(const std::string& name);
+
+  // Global functions with constant parameters are not emitted as they are,
+  // but specialized for each set of constant arguments. The constants are
+  // substituted into the body so that sizes of Array and delay are fixed.
+  std::unordered_map<std::string, std::shared_ptr<LambdaAST>> const_functions;
+  std::map<std::pair<std::string, std::vector<double>>, std::string>
+      specialized;
+  std::vector<AST_Ptr> specialized_defs;
+  std::unordered_map<std::string, double> const_params;
+  // globals assigned only once with number literal
+  std::unordered_map<std::string, double> global_numbers;
+  std::unordered_set<std::string> used_globals;
+  static bool hasConstParam(LambdaAST& ast);
+  double evalConstArg(const AST_Ptr& arg, const std::string& fname);
+  AST_Ptr specializeCall(FcallAST& ast, const std::string& fname);
+  std::string specialize(const std::string& fname,
+                         const std::vector<double>& values);
 
   std::shared_ptr<ListAST> currentcontext;
   std::shared_ptr<Environment<std::string>> env;
   int namecount;
   int envcount;
+  int listdepth;
   auto stackPopPtr() -> AST_Ptr {
     auto r = res_stack.top();
     res_stack.pop();
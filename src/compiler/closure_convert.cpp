@@ -22,11 +22,326 @@ bool ClosureConverter::isKnownFunction(const std::string& name) {
   return known_functions.find(name) != known_functions.end();
 }
 
+// the first assignment right after the allocation is the definition of
+// variable(e.g. y = x), the others overwrite the value.
+void ClosureConverter::collectReassigned(MIRblock& block, bool infunction) {
+  const std::string* allocated = nullptr;
+  for (auto& inst : block) {
+    std::visit(overloaded{[&](AssignInst& i) {
+                            bool isdef = allocated != nullptr &&
+                                         *allocated == i.lv_name;
+                            if (!isdef) {
+                              reassigned.emplace(i.lv_name);
+                              // closures may be kept beyond tasks
+                              region_safe &= !infunction ||
+                                             types::isPrimitive(i.type);
+                            }
+                          },
+                          [&](FunInst& i) { collectReassigned(*i.body, true); },
+                          [&](IfInst& i) {
+                            collectReassigned(*i.thenblock, infunction);
+                            collectReassigned(*i.elseblock, infunction);
+                          },
+                          [&](ForInst& i) {
+                            collectReassigned(*i.body, infunction);
+                          },
+                          [](auto& i) {}},
+               inst);
+    auto* alloca = std::get_if<AllocaInst>(&inst);
+    allocated = (alloca != nullptr) ? &alloca->lv_name : nullptr;
+  }
+}
+
+void ClosureConverter::specializeKnownCalls() {
+  // functions are registered after visited so that the specialized copies are
+  // made from the functions whose calls are already specialized.
+  std::unordered_map<std::string, FunInst*> funs;
+  auto& insts = toplevel->instructions;
+  for (auto it = insts.begin(); it != insts.end(); ++it) {
+    if (auto* fun = std::get_if<FunInst>(&*it)) {
+      for (auto& inst : *fun->body) {
+        specializeCall(inst, funs, it);
+      }
+      funs.emplace(fun->lv_name, fun);
+    } else {
+      specializeCall(*it, funs, it);
+    }
+  }
+  // originals which have function parameters cannot be emitted as they are.
+  std::unordered_set<std::string> used;
+  collectUsedNames(*toplevel, used);
+  insts.remove_if([&](Instructions& inst) {
+    auto* fun = std::get_if<FunInst>(&inst);
+    return fun != nullptr && used.count(fun->lv_name) == 0 &&
+           std::any_of(specialized.begin(), specialized.end(),
+                       [&](auto& s) { return s.first.first == fun->lv_name; });
+  });
+}
+
+void ClosureConverter::specializeCall(
+    Instructions& inst, std::unordered_map<std::string, FunInst*>& funs,
+    std::list<Instructions>::iterator position) {
+  auto recurse = [&](MIRblock& block) {
+    for (auto& i : block) {
+      specializeCall(i, funs, position);
+    }
+  };
+  if (auto* ifinst = std::get_if<IfInst>(&inst)) {
+    recurse(*ifinst->thenblock);
+    recurse(*ifinst->elseblock);
+  } else if (auto* forinst = std::get_if<ForInst>(&inst)) {
+    recurse(*forinst->body);
+  }
+  auto* fcall = std::get_if<FcallInst>(&inst);
+  if (fcall == nullptr || fcall->ftype != DIRECT) {
+    return;
+  }
+  auto fun = funs.find(fcall->fname);
+  if (fun == funs.end() || !isKnownFunction(fcall->fname)) {
+    return;
+  }
+  auto& params = fun->second->args;
+  auto& ftype = rv::get<types::Function>(typeenv.find(fcall->fname));
+  if (params.size() != fcall->args.size() ||
+      ftype.arg_types.size() != params.size()) {
+    return;
+  }
+  // known functions passed to the parameters only called in the body
+  std::vector<std::string> fargs;
+  bool hasfarg = false;
+  for (size_t k = 0; k < params.size(); k++) {
+    auto& a = fcall->args[k];
+    bool isknownfn =
+        funs.count(a) > 0 && isKnownFunction(a) &&
+        rv::holds_alternative<types::Function>(ftype.arg_types[k]) &&
+        isOnlyCalled(*fun->second->body, params[k]);
+    fargs.emplace_back(isknownfn ? a : "");
+    hasfarg |= isknownfn;
+  }
+  if (!hasfarg) {
+    return;
+  }
+  fcall->fname = specialize(*fun->second, fargs, position);
+  for (size_t k = fargs.size(); k-- > 0;) {
+    if (!fargs[k].empty()) {
+      fcall->args.erase(fcall->args.begin() + k);
+    }
+  }
+}
+
+std::string ClosureConverter::specialize(
+    FunInst& fun, std::vector<std::string>& fargs,
+    std::list<Instructions>::iterator position) {
+  auto key = std::make_pair(fun.lv_name, fargs);
+  auto it = specialized.find(key);
+  if (it != specialized.end()) {
+    return it->second;
+  }
+  auto newname = fun.lv_name + "$f" + std::to_string(specialized.size());
+  specialized.emplace(key, newname);
+  FunInst newfun = fun;
+  newfun.lv_name = newname;
+  newfun.body = std::make_shared<MIRblock>(newname);
+  auto ftype = rv::get<types::Function>(typeenv.find(fun.lv_name));
+  std::unordered_map<std::string, std::string> subst;
+  for (size_t k = fargs.size(); k-- > 0;) {
+    if (!fargs[k].empty()) {
+      subst.emplace(fun.args[k], fargs[k]);
+      newfun.args.erase(newfun.args.begin() + k);
+      ftype.arg_types.erase(ftype.arg_types.begin() + k);
+    }
+  }
+  cloneBlock(*fun.body, newfun.body, subst);
+  newfun.type = ftype;
+  typeenv.emplace(newname, std::move(ftype));
+  known_functions.emplace(newname, 1);
+  // placed before the statement of the call, after the function and arguments
+  Instructions newinst = std::move(newfun);
+  std::visit([&](auto& i) { i.setParent(toplevel); }, newinst);
+  toplevel->instructions.insert(position, std::move(newinst));
+  return newname;
+}
+
+bool ClosureConverter::isOnlyCalled(MIRblock& block, const std::string& name) {
+  auto has = [&](auto& names) {
+    return std::find(names.begin(), names.end(), name) != names.end();
+  };
+  for (auto& inst : block) {
+    bool used = std::visit(
+        overloaded{
+            [&](RefInst& i) { return i.val == name; },
+            [&](AssignInst& i) { return i.val == name; },
+            [&](OpInst& i) { return i.lhs == name || i.rhs == name; },
+            [&](FcallInst& i) { return has(i.args) || i.time == name; },
+            [&](MakeClosureInst& i) { return has(i.captures); },
+            [&](ArrayInst& i) { return has(i.args); },
+            [&](ArrayAccessInst& i) {
+              return i.name == name || i.index == name;
+            },
+            [&](IfInst& i) {
+              return i.cond == name ||
+                     (i.isexpr && (i.thenval == name || i.elseval == name)) ||
+                     !isOnlyCalled(*i.thenblock, name) ||
+                     !isOnlyCalled(*i.elseblock, name);
+            },
+            [&](ForInst& i) {
+              return i.count == name || !isOnlyCalled(*i.body, name);
+            },
+            [&](ReturnInst& i) { return i.val == name; },
+            [](auto& i) { return false; }},
+        inst);
+    if (used) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ClosureConverter::collectUsedNames(
+    MIRblock& block, std::unordered_set<std::string>& used) {
+  for (auto& inst : block) {
+    std::visit(
+        overloaded{
+            [&](RefInst& i) { used.emplace(i.val); },
+            [&](AssignInst& i) { used.emplace(i.val); },
+            [&](OpInst& i) { used.insert({i.lhs, i.rhs}); },
+            [&](FunInst& i) { collectUsedNames(*i.body, used); },
+            [&](FcallInst& i) {
+              used.emplace(i.fname);
+              used.insert(i.args.begin(), i.args.end());
+              if (i.time) {
+                used.emplace(i.time.value());
+              }
+            },
+            [&](MakeClosureInst& i) {
+              used.emplace(i.fname);
+              used.insert(i.captures.begin(), i.captures.end());
+            },
+            [&](ArrayInst& i) { used.insert(i.args.begin(), i.args.end()); },
+            [&](ArrayAccessInst& i) { used.insert({i.name, i.index}); },
+            [&](IfInst& i) {
+              used.insert({i.cond, i.thenval, i.elseval});
+              collectUsedNames(*i.thenblock, used);
+              collectUsedNames(*i.elseblock, used);
+            },
+            [&](ForInst& i) {
+              used.emplace(i.count);
+              collectUsedNames(*i.body, used);
+            },
+            [&](ReturnInst& i) { used.emplace(i.val); },
+            [](auto& i) {}},
+        inst);
+  }
+}
+
+void ClosureConverter::cloneBlock(
+    MIRblock& src, const std::shared_ptr<MIRblock>& dst,
+    std::unordered_map<std::string, std::string>& subst) {
+  for (auto& inst : src) {
+    Instructions copy = inst;
+    std::visit(overloaded{[&](FcallInst& i) {
+                            auto s = subst.find(i.fname);
+                            if (s != subst.end()) {
+                              i.fname = s->second;
+                              i.ftype = DIRECT;
+                            }
+                          },
+                          [&](IfInst& i) {
+                            auto thenblock = i.thenblock;
+                            auto elseblock = i.elseblock;
+                            i.thenblock =
+                                std::make_shared<MIRblock>(thenblock->label);
+                            i.elseblock =
+                                std::make_shared<MIRblock>(elseblock->label);
+                            cloneBlock(*thenblock, i.thenblock, subst);
+                            cloneBlock(*elseblock, i.elseblock, subst);
+                          },
+                          [&](ForInst& i) {
+                            auto body = i.body;
+                            i.body = std::make_shared<MIRblock>(body->label);
+                            cloneBlock(*body, i.body, subst);
+                          },
+                          [](auto& i) {}},
+               copy);
+    dst->addInst(copy);
+  }
+}
+
+// closures referred by return, assignment, arguments, arrays and captures of
+// other closures escape. calls with time only pass them to the scheduler.
+void ClosureConverter::collectEscapes(
+    MIRblock& block, std::vector<std::string>& closures,
+    std::unordered_set<std::string>& escaped,
+    std::unordered_set<std::string>& scheduled) {
+  auto recurse = [&](MIRblock& b) {
+    collectEscapes(b, closures, escaped, scheduled);
+  };
+  for (auto& inst : block) {
+    std::visit(
+        overloaded{
+            [&](MakeClosureInst& i) {
+              closures.push_back(i.fname);
+              escaped.insert(i.captures.begin(), i.captures.end());
+            },
+            [&](AssignInst& i) { escaped.emplace(i.val); },
+            [&](RefInst& i) { escaped.emplace(i.val); },
+            [&](FcallInst& i) {
+              escaped.insert(i.args.begin(), i.args.end());
+              if (i.time) {
+                scheduled.emplace(i.fname);
+              }
+            },
+            [&](ArrayInst& i) { escaped.insert(i.args.begin(), i.args.end()); },
+            [&](ReturnInst& i) { escaped.emplace(i.val); },
+            [&](IfInst& i) {
+              if (i.isexpr) {
+                escaped.emplace(i.thenval);
+                escaped.emplace(i.elseval);
+              }
+              recurse(*i.thenblock);
+              recurse(*i.elseblock);
+            },
+            [&](ForInst& i) { recurse(*i.body); },
+            [](auto& i) {}},
+        inst);
+  }
+}
+
+void ClosureConverter::analyzeEscape(MIRblock& body) {
+  std::vector<std::string> closures;
+  std::unordered_set<std::string> escaped;
+  std::unordered_set<std::string> scheduled;
+  collectEscapes(body, closures, escaped, scheduled);
+  for (auto& fname : closures) {
+    CaptureAlloc alloc = CaptureAlloc::STACK;
+    if (escaped.count(fname) > 0 || escaped.count(fname + "_cls") > 0) {
+      alloc = region_safe ? CaptureAlloc::REGION : CaptureAlloc::HEAP;
+    } else if (scheduled.count(fname) > 0) {
+      alloc = CaptureAlloc::POOL;
+    }
+    capture_alloc.insert_or_assign(fname, alloc);
+  }
+}
+
 void ClosureConverter::moveFunToTop(std::shared_ptr<MIRblock> mir) {
   auto& tinsts = toplevel->instructions;
   for (auto it = mir->instructions.begin(), end = mir->instructions.end();
        it != end; ++it) {
     auto& cinst = *it;
+    std::vector<std::shared_ptr<MIRblock>> childblocks;
+    if (auto* ifinst = std::get_if<IfInst>(&cinst)) {
+      childblocks = {ifinst->thenblock, ifinst->elseblock};
+    }
+    if (auto* forinst = std::get_if<ForInst>(&cinst)) {
+      childblocks = {forinst->body};
+    }
+    // functions defined in branches and loops are also lifted to toplevel
+    for (auto& block : childblocks) {
+      moveFunToTop(block);
+      block->instructions.remove_if([](Instructions v) {
+        return std::visit([](auto v) -> bool { return v.isFunction(); }, v);
+      });
+    }
     if (std::holds_alternative<FunInst>(cinst)) {
       auto f = std::get<FunInst>(cinst);  // copy
       moveFunToTop(f.body);
@@ -44,6 +359,7 @@ std::shared_ptr<MIRblock> ClosureConverter::convert(
     std::shared_ptr<MIRblock> toplevel) {
   // convert top level
   this->toplevel = toplevel;
+  collectReassigned(*toplevel);
   auto& inss = toplevel->instructions;
   auto pos = inss.begin();
   std::vector<std::string> fvlist;
@@ -58,6 +374,13 @@ std::shared_ptr<MIRblock> ClosureConverter::convert(
     // std::visit(typereplacer, cinst);
   }
   moveFunToTop(this->toplevel);
+  specializeKnownCalls();
+  // closures in global context are allocated once and never analyzed.
+  for (auto& inst : *this->toplevel) {
+    if (auto* fun = std::get_if<FunInst>(&inst)) {
+      analyzeEscape(*fun->body);
+    }
+  }
   if(! (clstypeenv.count("dsp")>0) ){
     auto dummycapture= types::Alias(makeCaptureName(),types::Tuple({}));
     auto dummytype = types::Alias(makeClosureTypeName(),types::Closure(types::Ref(types::Function(types::Float(),{types::Float(),types::Ref(dummycapture)})),dummycapture));
@@ -134,7 +457,12 @@ checkpoint:
       if(rv::holds_alternative<types::Function>(ft)){
         ft = cc.typeenv.find(fv+"_cls");
       }
-      fvtype_inside.emplace_back(types::Ref(ft));
+      if (types::isPrimitive(ft) && cc.reassigned.count(fv) == 0) {
+        cc.byvalue_captures.emplace(fv);
+        fvtype_inside.emplace_back(ft);
+      } else {
+        fvtype_inside.emplace_back(types::Ref(ft));
+      }
       }else{
         fvlist.erase(it);
       }
@@ -224,7 +552,10 @@ void ClosureConverter::CCVisitor::operator()(MakeClosureInst& i) {
 }
 
 void ClosureConverter::CCVisitor::operator()(ArrayInst& i) {
-  // todo
+  for (auto& a : i.args) {
+    registerFv(a);
+  }
+  localvlist.push_back(i.lv_name);
 }
 
 void ClosureConverter::CCVisitor::operator()(ArrayAccessInst& i) {
@@ -234,7 +565,31 @@ void ClosureConverter::CCVisitor::operator()(ArrayAccessInst& i) {
 }
 
 void ClosureConverter::CCVisitor::operator()(IfInst& i) {
-  // todo
+  registerFv(i.cond);
+  auto tmppos = position;
+  for (auto& block : {i.thenblock, i.elseblock}) {
+    for (auto it = block->begin(), end = block->end(); it != end; ++it) {
+      position = it;
+      std::visit(*this, *it);
+    }
+  }
+  position = tmppos;
+  if (i.isexpr) {
+    registerFv(i.thenval);
+    registerFv(i.elseval);
+  }
+  localvlist.push_back(i.lv_name);
+}
+
+void ClosureConverter::CCVisitor::operator()(ForInst& i) {
+  registerFv(i.count);
+  localvlist.push_back(i.loopvar);
+  auto tmppos = position;
+  for (auto it = i.body->begin(), end = i.body->end(); it != end; ++it) {
+    position = it;
+    std::visit(*this, *it);
+  }
+  position = tmppos;
 }
 
 void ClosureConverter::CCVisitor::operator()(ReturnInst& i) {
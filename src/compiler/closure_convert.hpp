@@ -7,6 +7,14 @@
 #include "basic/variant_visitor_helper.hpp"
 #include "compiler/ffi.hpp"
 namespace mimium {
+// where the capture of a closure created in a function is placed, decided by
+// escape analysis.
+enum class CaptureAlloc {
+  HEAP,    // escapes from the creating function
+  STACK,   // used only inside the creating function
+  POOL,    // escapes only into scheduled tasks, released by the scheduler
+  REGION   // escapes, taken from the region of the running task
+};
 
 class ClosureConverter : public std::enable_shared_from_this<ClosureConverter> {
 
@@ -19,6 +27,15 @@ class ClosureConverter : public std::enable_shared_from_this<ClosureConverter> {
 
   auto& getCaptureNames(const std::string& fname){return fvinfo[fname];}
   auto& getCaptureType(const std::string& fname){return clstypeenv[fname];}
+  // primitive variables never reassigned are copied into the closure instead
+  // of being referred through the pointer.
+  bool isCapturedByValue(const std::string& name) {
+    return byvalue_captures.count(name) > 0;
+  }
+  CaptureAlloc getCaptureAlloc(const std::string& fname) {
+    auto it = capture_alloc.find(fname);
+    return (it == capture_alloc.end()) ? CaptureAlloc::HEAP : it->second;
+  }
   void dump();
 
  private:
@@ -30,10 +47,37 @@ class ClosureConverter : public std::enable_shared_from_this<ClosureConverter> {
   std::unordered_map<std::string, std::vector<std::string>> fvinfo;
   // fname: types::Tuple(...)
   std::unordered_map<std::string, types::Value> clstypeenv;
+  std::unordered_set<std::string> reassigned;
+  // false if functions overwrite variables with closures, which then may
+  // outlive the task that created them.
+  bool region_safe = true;
+  std::unordered_set<std::string> byvalue_captures;
+  std::unordered_map<std::string, CaptureAlloc> capture_alloc;
   FunInst tmp_globalfn;
 
   void moveFunToTop(std::shared_ptr<MIRblock> mir);
   bool isKnownFunction(const std::string& name);
+  void collectReassigned(MIRblock& block, bool infunction = false);
+  // Calls of known functions with known functions as arguments are made into
+  // direct calls of copies, in which the function parameters are replaced by
+  // the arguments(e.g. hof(x,double) calls hof$f0(x) that calls double).
+  std::map<std::pair<std::string, std::vector<std::string>>, std::string>
+      specialized;
+  void specializeKnownCalls();
+  void specializeCall(Instructions& inst,
+                      std::unordered_map<std::string, FunInst*>& funs,
+                      std::list<Instructions>::iterator position);
+  std::string specialize(FunInst& fun, std::vector<std::string>& fargs,
+                         std::list<Instructions>::iterator position);
+  static bool isOnlyCalled(MIRblock& block, const std::string& name);
+  static void collectUsedNames(MIRblock& block,
+                               std::unordered_set<std::string>& used);
+  static void cloneBlock(MIRblock& src, const std::shared_ptr<MIRblock>& dst,
+                         std::unordered_map<std::string, std::string>& subst);
+  void analyzeEscape(MIRblock& body);
+  void collectEscapes(MIRblock& block, std::vector<std::string>& closures,
+                      std::unordered_set<std::string>& escaped,
+                      std::unordered_set<std::string>& scheduled);
   std::string makeCaptureName() {
     return "Capture." + std::to_string(capturecount++);
   }
@@ -68,6 +112,7 @@ class ClosureConverter : public std::enable_shared_from_this<ClosureConverter> {
     void operator()(ArrayInst& i);
     void operator()(ArrayAccessInst& i);
     void operator()(IfInst& i);
+    void operator()(ForInst& i);
     void operator()(ReturnInst& i);
     bool isFreeVar(const std::string& name);
     private:
@@ -3,6 +3,8 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #pragma once
+#include <set>
+
 #include "compiler/codegen/llvmgenerator.hpp"
 
 namespace mimium {
@@ -24,12 +26,16 @@ struct CodeGenVisitor : public std::enable_shared_from_this<CodeGenVisitor> {
   void operator()(ArrayInst& i);
   void operator()(ArrayAccessInst& i);
   void operator()(IfInst& i);
+  void operator()(ForInst& i);
   void operator()(ReturnInst& i);
 
  private:
   LLVMGenerator& G;
   bool isglobal;
   std::string context_hasself;
+  // jump target and arguments of self tail call in current function
+  llvm::BasicBlock* context_tailrecurse = nullptr;
+  std::vector<std::string> context_tailargs;
   llvm::Value* getDirFun(FcallInst& i);
   llvm::Value* getClsFun(FcallInst& i);
   llvm::Value* getExtFun(FcallInst& i);
@@ -44,9 +50,52 @@ struct CodeGenVisitor : public std::enable_shared_from_this<CodeGenVisitor> {
   llvm::Value* createAllocation(bool isglobal, llvm::Type* type,
                                 llvm::Value* ArraySize,
                                 const llvm::Twine& name);
+  llvm::Value* createRuntimeAllocation(const std::string& allocator,
+                                       llvm::Type* type,
+                                       const llvm::Twine& name);
   bool createStoreOw(std::string varname, llvm::Value* val_to_store);
+  llvm::Value* createFloatToBool(llvm::Value* v);
+  llvm::Value* createBoolToFloat(llvm::Value* v, OpInst& i);
+  llvm::Value* createFloatToInt(llvm::Value* v);
+  llvm::Value* createIntToFloat(llvm::Value* v, OpInst& i);
+  llvm::Value* createFPCast(llvm::Value* v, llvm::Type* type);
+  llvm::Value* createIntOp(OpInst& i, llvm::Value* lhs, llvm::Value* rhs);
+  llvm::Value* createIntToBool(llvm::Value* v);
+  llvm::Value* createBroadcast(llvm::Value* v, int size);
+  llvm::Value* createDelay(FcallInst& i, std::vector<llvm::Value*>& args);
+  llvm::Value* createCacheCheck(FcallInst& i);
+  llvm::Value* createNoise(FcallInst& i);
+  llvm::Value* createRandomStep(llvm::Value* state);
+  void createHistoryWrite(FunInst& i);
+  llvm::Value* createHistoryRead(FcallInst& i, std::vector<llvm::Value*>& args);
+  llvm::Value* createArrayBoundary(llvm::Value* index, int size,
+                                   BOUNDARY mode);
+  llvm::Value* createInlineBuiltin(FcallInst& i,
+                                   std::vector<llvm::Value*>& args);
+  llvm::Value* createApproxMath(const std::string& fname, llvm::Value* x);
+  llvm::Value* createApproxSin(llvm::Value* x);
+  llvm::Value* createApproxPow2(llvm::Value* x);
+  llvm::Value* createPolynomial(llvm::Value* x,
+                                const std::vector<double>& coeffs);
+  llvm::Value* createClamp(llvm::Value* x, double min, double max);
+  std::pair<llvm::Value*, llvm::BasicBlock*> createIfBranch(
+      MIRblock& block, const std::string& resname, llvm::BasicBlock* bb,
+      llvm::BasicBlock* mergebb);
+  void collectAssignedNames(MIRblock& block, std::set<std::string>& names);
+  void reloadVariables(const std::set<std::string>& names);
+  llvm::MDNode* createLoopMetadata();
+  void restoreVariableMap(
+      const std::unordered_map<std::string, llvm::Value*>& snapshot,
+      std::set<std::string>& assigned);
   void createAddTaskFn(FcallInst& i, bool isclosure, bool isglobal);
+  void createTailRecurseBlock(llvm::Function* f, FunInst& i);
+  void createTailCall(FcallInst& i);
 
   const static std::unordered_map<OP_ID, std::string> opid_to_ffi;
+  const static std::unordered_map<std::string, llvm::Instruction::CastOps>
+      builtin_to_cast;
+  const static std::unordered_map<std::string, llvm::Intrinsic::ID>
+      builtin_to_intrinsic;
+  const static std::unordered_set<std::string> approx_builtins;
 };
 }  // namespace mimium
\ No newline at end of file
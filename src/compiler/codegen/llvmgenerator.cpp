@@ -4,6 +4,9 @@
  
 #include "compiler/codegen/llvmgenerator.hpp"
 
+#include <array>
+#include <functional>
+
 namespace mimium {
 
 LLVMGenerator::LLVMGenerator(llvm::LLVMContext& ctx, TypeEnv& typeenv,ClosureConverter& cc,
@@ -29,6 +32,19 @@ void LLVMGenerator::setDataLayout(const llvm::DataLayout& dl) {
   module->setDataLayout(dl);
 }
 
+llvm::FastMathFlags LLVMGenerator::getFastMathFlags(FPMODE mode) {
+  llvm::FastMathFlags flags;
+  if (mode == FPMODE::FAST || (mode == FPMODE::DEFAULT && fastmath)) {
+    flags.setAllowContract(true);
+    flags.setAllowReassoc();
+    flags.setNoNaNs();
+    flags.setNoInfs();
+    flags.setApproxFunc();
+    flags.setAllowReciprocal();
+  }
+  return flags;
+}
+
 void LLVMGenerator::reset(std::string filename) {
   dropAllReferences();
   init(filename);
@@ -58,19 +74,63 @@ llvm::Type* LLVMGenerator::getClosureToFunType(types::Value& type) {
   types::Value v = fty;
   return std::visit(typeconverter, v);
 }
-void LLVMGenerator::switchToMainFun() {
-  setBB(mainentry);
-  currentblock = mainentry;
+void LLVMGenerator::switchToMainFun(llvm::BasicBlock* block) {
+  setBB(block);
+  currentblock = block;
   curfunc = mainentry->getParent();
 }
+// In single precision mode, functions which have float variant (sinf etc.)
+// are replaced with it, and the others are called with double arguments.
 llvm::Function* LLVMGenerator::getForeignFunction(const std::string& name) {
   auto& [type, targetname] = LLVMBuiltin::ftable.find(name)->second;
+  bool issingle = typeconverter.f32;
+  bool hasvariant = LLVMBuiltin::f32_variants.count(targetname) > 0;
+  auto fname = (issingle && hasvariant) ? targetname + "f" : targetname;
+  typeconverter.f32 = issingle && hasvariant;
   auto funtype = llvm::cast<llvm::FunctionType>(getType(type));
-  auto fnc = module->getOrInsertFunction(targetname, funtype);
+  typeconverter.f32 = issingle;
+  auto fnc = module->getOrInsertFunction(fname, funtype);
   auto* fn = llvm::cast<llvm::Function>(fnc.getCallee());
   fn->setCallingConv(llvm::CallingConv::C);
   return fn;
 }
+// The runtime calls dsp and scheduled tasks with double arguments. In single
+// precision mode, they are called through a wrapper which converts float
+// arguments and return value.
+llvm::Function* LLVMGenerator::getF64Wrapper(
+    llvm::Function* f, const std::string& name,
+    llvm::GlobalValue::LinkageTypes link) {
+  if (auto* wrapper = module->getFunction(name)) {
+    return wrapper;
+  }
+  llvm::IRBuilder<> b(ctx);
+  auto todouble = [&](llvm::Type* t) {
+    return t->isFloatTy() ? b.getDoubleTy() : t;
+  };
+  std::vector<llvm::Type*> params;
+  for (auto* t : f->getFunctionType()->params()) {
+    params.emplace_back(todouble(t));
+  }
+  auto* rettype = todouble(f->getReturnType());
+  auto* fntype = llvm::FunctionType::get(rettype, params, false);
+  auto* wrapper = llvm::Function::Create(fntype, link, name, *module);
+  b.SetInsertPoint(llvm::BasicBlock::Create(ctx, "entry", wrapper));
+  auto cast = [&](llvm::Value* v, llvm::Type* t) {
+    return (v->getType() == t) ? v : b.CreateFPCast(v, t);
+  };
+  std::vector<llvm::Value*> args;
+  auto param = f->arg_begin();
+  for (auto& a : wrapper->args()) {
+    args.emplace_back(cast(&a, (param++)->getType()));
+  }
+  auto* res = b.CreateCall(f, args);
+  if (rettype->isVoidTy()) {
+    b.CreateRetVoid();
+  } else {
+    b.CreateRet(cast(res, rettype));
+  }
+  return wrapper;
+}
 
 void LLVMGenerator::setBB(llvm::BasicBlock* newblock) {
   builder->SetInsertPoint(newblock);
@@ -86,6 +146,11 @@ void LLVMGenerator::createMiscDeclarations() {
   auto* malloctype = llvm::FunctionType::get(i8ptr, {i64}, false);
   auto res = module->getOrInsertFunction("malloc", malloctype).getCallee();
   setValuetoMap("malloc", res);
+  // allocators of closures defined in scheduler.cpp
+  for (const auto* name : {"mimium_pool_alloc", "mimium_region_alloc"}) {
+    auto alloc = module->getOrInsertFunction(name, malloctype).getCallee();
+    setValuetoMap(name, alloc);
+  }
   // create llvm memset
   auto* memsettype = llvm::FunctionType::get(vo, {i8ptr, i8, i64, b}, false);
   module->getOrInsertFunction("llvm.memset.p0i8.i64",memsettype).getCallee();
@@ -205,6 +270,121 @@ void LLVMGenerator::preprocess() {
   createTaskRegister(false);  // for closure
   setBB(mainentry);
 }
+// the instructions in the top level and in its if statements are executed at
+// most once, the others in for statement keep being allocated by malloc.
+void LLVMGenerator::createGlobalStorage(MIRblock& toplevel) {
+  std::vector<llvm::Type*> fields;
+  globals_index.clear();
+  auto addfield = [&](const std::string& name, llvm::Type* type) {
+    if (type->isSized()) {
+      globals_index.emplace(name, fields.size());
+      fields.push_back(type);
+    }
+  };
+  std::function<void(MIRblock&)> collect = [&](MIRblock& block) {
+    for (auto& inst : block) {
+      if (auto* alloca = std::get_if<AllocaInst>(&inst)) {
+        addfield(alloca->lv_name, getType(alloca->lv_name));
+      } else if (auto* mkcls = std::get_if<MakeClosureInst>(&inst)) {
+        addfield("ptr_" + mkcls->fname + ".cap",
+                 getType(cc.getCaptureType(mkcls->fname)));
+      } else if (auto* ifinst = std::get_if<IfInst>(&inst)) {
+        collect(*ifinst->thenblock);
+        collect(*ifinst->elseblock);
+      }
+    }
+  };
+  collect(toplevel);
+  if (fields.empty()) {
+    globals = nullptr;
+    return;
+  }
+  auto* type = llvm::StructType::create(ctx, fields, "mimium.globals.type");
+  globals = new llvm::GlobalVariable(
+      *module, type, false, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantAggregateZero::get(type), "mimium.globals");
+#if LLVM_VERSION_MAJOR >= 10
+  globals->setAlignment(llvm::MaybeAlign(64));
+#else
+  globals->setAlignment(64);
+#endif
+}
+// Propagated until no more value becomes wide, as functions may be defined
+// before their callers.
+void LLVMGenerator::collectWideValues(MIRblock& toplevel) {
+  wide_values.clear();
+  if (!typeconverter.f32) {
+    return;
+  }
+  std::unordered_map<std::string, FunInst*> functions;
+  for (auto& inst : toplevel) {
+    if (auto* fun = std::get_if<FunInst>(&inst)) {
+      functions.emplace(fun->lv_name, fun);
+    }
+  }
+  auto isfloat = [&](const std::string& name) {
+    auto* type = typeenv.tryFind(name);
+    return type != nullptr && std::holds_alternative<types::Float>(*type);
+  };
+  bool changed = true;
+  auto add = [&](const std::string& name) {
+    changed |= wide_values.emplace(name).second;
+  };
+  std::function<void(MIRblock&)> collect = [&](MIRblock& block) {
+    for (auto& inst : block) {
+      if (auto* fun = std::get_if<FunInst>(&inst)) {
+        if (fun->lv_name == "dsp" && !fun->args.empty() &&
+            isfloat(fun->args.front())) {
+          add(fun->args.front());
+        }
+        collect(*fun->body);
+      } else if (auto* op = std::get_if<OpInst>(&inst)) {
+        auto id = op->getOPid();
+        bool isarith = id == OP_ID::ADD || id == OP_ID::SUB ||
+                       id == OP_ID::MUL || id == OP_ID::DIV ||
+                       id == OP_ID::MOD;
+        if (isarith && std::holds_alternative<types::Float>(op->type) &&
+            (isWide(op->lhs) || isWide(op->rhs))) {
+          add(op->lv_name);
+        }
+      } else if (auto* fcall = std::get_if<FcallInst>(&inst)) {
+        if (fcall->fname == "mimium_getnow") {
+          add(fcall->lv_name);
+        }
+        auto callee = functions.find(fcall->fname);
+        if (callee == functions.end()) {
+          continue;
+        }
+        auto& params = callee->second->args;
+        for (size_t k = 0; k < fcall->args.size() && k < params.size(); k++) {
+          if (isWide(fcall->args[k]) && isfloat(params[k])) {
+            add(params[k]);
+          }
+        }
+      } else if (auto* ifinst = std::get_if<IfInst>(&inst)) {
+        collect(*ifinst->thenblock);
+        collect(*ifinst->elseblock);
+      } else if (auto* forinst = std::get_if<ForInst>(&inst)) {
+        collect(*forinst->body);
+      }
+    }
+  };
+  while (changed) {
+    changed = false;
+    collect(toplevel);
+  }
+}
+llvm::Constant* LLVMGenerator::getGlobalStorage(const std::string& name) {
+  auto it = globals_index.find(name);
+  if (globals == nullptr || it == globals_index.end()) {
+    return nullptr;
+  }
+  std::array<llvm::Constant*, 2> idx = {builder->getInt32(0),
+                                        builder->getInt32(it->second)};
+  return llvm::ConstantExpr::getInBoundsGetElementPtr(globals->getValueType(),
+                                                      globals, idx);
+}
+
 void LLVMGenerator::visitInstructions(Instructions& inst, bool isglobal) {
   codegenvisitor->isglobal = isglobal;
   std::visit(*codegenvisitor, inst);
@@ -212,34 +392,58 @@ void LLVMGenerator::visitInstructions(Instructions& inst, bool isglobal) {
 
 void LLVMGenerator::generateCode(std::shared_ptr<MIRblock> mir) {
   preprocess();
+  createGlobalStorage(*mir);
+  collectWideValues(*mir);
+  builder->setFastMathFlags(getFastMathFlags(FPMODE::DEFAULT));
   for (auto& inst : mir->instructions) {
     visitInstructions(inst, true);
   }
-  if(module->getFunction("dsp")!=nullptr){
-  createRuntimeSetDspFn();
+  if (auto* dsp = module->getFunction("dsp"); dsp != nullptr) {
+    if (typeconverter.f32) {
+      dsp->setName("dsp.f32");
+      getF64Wrapper(dsp, "dsp", llvm::Function::ExternalLinkage);
+    }
+    createRuntimeSetDspFn();
   }
   // main always return null for now;
   builder->CreateRet(llvm::ConstantPointerNull::get(builder->getInt8PtrTy()));
 }
 
-llvm::Value* LLVMGenerator::tryfindValue(std::string name) {
+llvm::Value* LLVMGenerator::tryfindWideValue(std::string name) {
   auto map = variable_map[curfunc];
   auto res = map->find(name);
   return (res == map->end()) ? nullptr : res->second;
 }
-llvm::Value* LLVMGenerator::findValue(std::string name) {
-  auto* res = tryfindValue(name);
+llvm::Value* LLVMGenerator::findWideValue(std::string name) {
+  auto* res = tryfindWideValue(name);
   if (res == nullptr) {
     throw std::runtime_error("variable " + name +
                              " cannot be found in llvm conversion");
   }
   return res;
 }
+llvm::Value* LLVMGenerator::tryfindValue(std::string name) {
+  auto* res = tryfindWideValue(name);
+  return (res == nullptr) ? nullptr : narrowToFloat(res);
+}
+llvm::Value* LLVMGenerator::findValue(std::string name) {
+  return narrowToFloat(findWideValue(name));
+}
+llvm::Value* LLVMGenerator::narrowToFloat(llvm::Value* v) {
+  if (!typeconverter.f32 || !v->getType()->isDoubleTy()) {
+    return v;
+  }
+  return builder->CreateFPTrunc(v, typeconverter.getFloatTy());
+}
 
 void LLVMGenerator::setValuetoMap(std::string name, llvm::Value* val) {
   auto map = variable_map[curfunc];
   map->try_emplace(name, val);
 }
+void LLVMGenerator::overwriteValuetoMap(std::string name, llvm::Value* val) {
+  auto map = variable_map[curfunc];
+  map->insert_or_assign(name, val);
+}
 
 void LLVMGenerator::outputToStream(llvm::raw_ostream& stream) {
   module->print(stream, nullptr, false, true);
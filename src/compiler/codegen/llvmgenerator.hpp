@@ -3,6 +3,8 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #pragma once
+#include <unordered_set>
+
 #include "basic/ast.hpp"
 #include "basic/helper_functions.hpp"
 #include "basic/mir.hpp"
@@ -33,6 +35,17 @@ friend struct CodeGenVisitor;
   std::shared_ptr<CodeGenVisitor> codegenvisitor;
   ClosureConverter& cc;
   MemoryObjsCollector& memobjcoll;
+  bool fastmath = false;
+  uint64_t rng_seed = 0;  // initial value of the counter to seed noises
+  // flags for the function with the given mode, DEFAULT follows fastmath.
+  llvm::FastMathFlags getFastMathFlags(FPMODE mode);
+  // storage of top-level variables and closure captures are packed into one
+  // cache-aligned struct so that their addresses are known at compile time.
+  llvm::GlobalVariable* globals = nullptr;
+  std::unordered_map<std::string, unsigned int> globals_index;
+  void createGlobalStorage(MIRblock& toplevel);
+  // returns nullptr if the name is not placed in the global storage
+  llvm::Constant* getGlobalStorage(const std::string& name);
 
   llvm::FunctionCallee addtask;
   llvm::FunctionCallee addtask_cls;
@@ -47,10 +60,25 @@ friend struct CodeGenVisitor;
       
   llvm::Value* findValue(std::string name);
   llvm::Value* tryfindValue(std::string name);
-  void switchToMainFun();
+  // In single precision mode, time is kept in double because float cannot
+  // count samples beyond 2^24. Wide values are the time argument of dsp,
+  // results of now, arithmetics on them and arguments of functions receiving
+  // them. findValue narrows them to float, while the raw ones are used for
+  // arithmetics, function calls and scheduling.
+  std::unordered_set<std::string> wide_values;
+  void collectWideValues(MIRblock& toplevel);
+  bool isWide(const std::string& name) { return wide_values.count(name) > 0; }
+  llvm::Value* narrowToFloat(llvm::Value* v);
+  llvm::Value* findWideValue(std::string name);
+  llvm::Value* tryfindWideValue(std::string name);
+  void switchToMainFun(llvm::BasicBlock* block);
   void setValuetoMap(std::string name, llvm::Value* val);
+  void overwriteValuetoMap(std::string name, llvm::Value* val);
   void preprocess();
   llvm::Function* getForeignFunction(const std::string& name);
+  llvm::Function* getF64Wrapper(
+      llvm::Function* f, const std::string& name,
+      llvm::GlobalValue::LinkageTypes link = llvm::Function::InternalLinkage);
   void createMiscDeclarations();
   void createRuntimeSetDspFn();
   void createMainFun();
@@ -69,6 +97,9 @@ friend struct CodeGenVisitor;
   ~LLVMGenerator();
   void init(std::string filename);
   void setDataLayout(const llvm::DataLayout& dl);
+  void setFastMath(bool flag) { fastmath = flag; }
+  void setRandomSeed(uint64_t seed) { rng_seed = seed; }
+  void setSinglePrecision(bool flag) { typeconverter.f32 = flag; }
   void reset(std::string filename);
   void setBB(llvm::BasicBlock* newblock);
   void generateCode(std::shared_ptr<MIRblock> mir);
@@ -17,8 +17,19 @@ llvm::Type* TypeConverter::operator()(types::TypeVar& i) {
 llvm::Type* TypeConverter::operator()(types::Void& i) {
   return builder.getVoidTy();
 }
-llvm::Type* TypeConverter::operator()(types::Float& i) {
-  return builder.getDoubleTy();
+llvm::Type* TypeConverter::getFloatTy() {
+  return f32 ? builder.getFloatTy() : builder.getDoubleTy();
+}
+llvm::Type* TypeConverter::operator()(types::Float& i) { return getFloatTy(); }
+llvm::Type* TypeConverter::operator()(types::Int& i) {
+  return builder.getInt64Ty();
+}
+llvm::Type* TypeConverter::operator()(types::Vector& i) {
+#if LLVM_VERSION_MAJOR >= 11
+  return llvm::FixedVectorType::get(getFloatTy(), i.size);
+#else
+  return llvm::VectorType::get(getFloatTy(), i.size);
+#endif
 }
 llvm::Type* TypeConverter::operator()(types::String& i) {
   return builder.getInt8PtrTy();
@@ -47,15 +58,31 @@ llvm::Type* TypeConverter::operator()(types::Closure& i) {
   return llvm::StructType::create(builder.getContext(), {fty, capturetype},
                                   name, false);
 }
+// array value is a pointer to its first element, its storage is made by
+// getMemberType() or ArrayInst.
 llvm::Type* TypeConverter::operator()(types::Array& i) {
   return llvm::PointerType::get(std::visit(*this, i.elem_type),0);
 }
+// sized array held by memory object is stored inline, not as a pointer.
+llvm::Type* TypeConverter::getMemberType(types::Value& v) {
+  if (rv::holds_alternative<types::Alias>(v)) {
+    auto& alias = rv::get<types::Alias>(v);
+    if (rv::holds_alternative<types::Array>(alias.target)) {
+      auto& arr = rv::get<types::Array>(alias.target);
+      if (arr.size > 0) {
+        return llvm::ArrayType::get(std::visit(*this, arr.elem_type),
+                                    arr.size);
+      }
+    }
+  }
+  return std::visit(*this, v);
+}
 llvm::Type* TypeConverter::operator()(types::Struct& i) {
   std::vector<llvm::Type*> ar;
   llvm::Type* res;
   auto t = static_cast<types::Tuple>(i);
   for (auto& a : t.arg_types) {
-    ar.push_back(std::visit(*this, a));
+    ar.push_back(getMemberType(a));
   }
   if (tmpname.empty()) {
     res = llvm::StructType::get(builder.getContext(), ar);
@@ -72,7 +99,7 @@ llvm::Type* TypeConverter::operator()(types::Tuple& i) {
   std::vector<llvm::Type*> ar;
   llvm::Type* res;
   for (auto& a : i.arg_types) {
-    ar.push_back(std::visit(*this, a));
+    ar.push_back(getMemberType(a));
   }
   if (tmpname.empty()) {
     res = llvm::StructType::get(builder.getContext(), ar, false);
@@ -13,6 +13,7 @@ struct TypeConverter {
   llvm::IRBuilder<>& builder;
   llvm::Module& module;
   std::string tmpname;
+  bool f32 = false;  // lower Float to float instead of double
   std::unordered_map<std::string, llvm::Type*> aliasmap;
   static void error() { throw std::logic_error("Invalid Type"); }
 
@@ -20,6 +21,8 @@ struct TypeConverter {
   llvm::Type* operator()(types::TypeVar& i);
   llvm::Type* operator()(types::Void& i);
   llvm::Type* operator()(types::Float& i);
+  llvm::Type* operator()(types::Int& i);
+  llvm::Type* operator()(types::Vector& i);
   llvm::Type* operator()(types::String& i);
   llvm::Type* operator()(types::Ref& i);
   llvm::Type* operator()(types::Pointer& i);
@@ -30,6 +33,8 @@ struct TypeConverter {
   llvm::Type* operator()(types::Tuple& i);
   // llvm::Type* operator()(types::Time& i);
   llvm::Type* operator()(types::Alias& i);
+  llvm::Type* getMemberType(types::Value& v);
+  llvm::Type* getFloatTy();
 
  private:
   [[nodiscard]]std::string consumeAlias();
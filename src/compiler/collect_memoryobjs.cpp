@@ -59,11 +59,79 @@ void MemoryObjsCollector::collectSelf(std::string& funname,
     varname = newname + ".mem";
   }
 }
-void MemoryObjsCollector::collectDelay(std::string& funname, int delay_size) {
-  auto delayname = "delay." + std::to_string(delay_size);
-  emplaceNewAlias(delayname, types::Array(types::Float(), delay_size));
+// the ring buffer of delay is collected as ArrayInst, here its write position
+// is registered.
+void MemoryObjsCollector::collectDelay(std::string& funname,
+                                       std::string& name) {
+  auto delayname = funname + "." + name;
+  emplaceNewAlias(delayname, types::Int());
   memobjs_map[funname].emplace_back(delayname);
 }
+// cache of event-rate value keeps the version of globals when it was computed
+// and the value.
+void MemoryObjsCollector::collectCache(std::string& funname,
+                                       std::string& name) {
+  auto cachename = funname + "." + name;
+  auto valname = cachename + ".value";
+  emplaceNewAlias(cachename, types::Int());
+  emplaceNewAlias(valname, types::Float());
+  memobjs_map[funname].emplace_back(cachename);
+  memobjs_map[funname].emplace_back(valname);
+}
+// state of random number generator, and of the filter for pink noise.
+void MemoryObjsCollector::collectNoise(std::string& funname, std::string& name,
+                                       bool ispink) {
+  auto statename = funname + "." + name;
+  emplaceNewAlias(statename, types::Int());
+  memobjs_map[funname].emplace_back(statename);
+  for (int k = 0; ispink && k < 3; k++) {
+    auto polename = statename + ".pink" + std::to_string(k);
+    emplaceNewAlias(polename, types::Float());
+    memobjs_map[funname].emplace_back(polename);
+  }
+}
+// history(var,n) of the same variable shares one ring buffer in a function,
+// its length is extended to the longest lookback while the body is visited.
+// The buffer is written at the beginning of the function, where self still
+// holds the output of 1 sample before.
+void MemoryObjsCollector::collectHistory(std::string& funname, FcallInst& i,
+                                         int length) {
+  auto& var = i.args[0];
+  bool isself = var == "self";
+  auto histname = funname + "." + var + ".history";
+  int required = isself ? length : length + 1;
+  int size = 1;
+  while (size < required) {
+    size <<= 1;
+  }
+  auto it = type_alias_map.find(histname);
+  if (it == type_alias_map.end()) {
+    std::string valname = var;
+    collectSelf(funname, valname);
+    auto posname = histname + ".pos";
+    emplaceNewAlias(posname, types::Int());
+    memobjs_map[funname].emplace_back(histname);
+    memobjs_map[funname].emplace_back(posname);
+    history_map[funname].emplace_back(histname, valname);
+  } else {
+    auto& buf = rv::get<types::Array>(it->second.target);
+    size = std::max(size, buf.size);
+  }
+  type_alias_map.insert_or_assign(
+      histname, types::Alias(histname, types::Array(i.type, size)));
+  // destructive: refer to the buffer instead of the variable
+  var = histname + ".mem";
+}
+// Array(size) declared in a function keeps its contents between calls, so the
+// storage is placed inline in the memory object of the function.
+void MemoryObjsCollector::collectArray(std::string& funname, ArrayInst& i) {
+  if (!i.args.empty()) {
+    return;  // array literal is re-evaluated on every call
+  }
+  auto newname = funname + "." + i.lv_name;
+  emplaceNewAlias(newname, i.type);
+  memobjs_map[funname].emplace_back(newname);
+}
 void MemoryObjsCollector::collectMemPrim(std::string& funname,std::string& argname) {
   // auto newname = (funname + ".memprim");
   // bool ismemprim = (varname == "mem");
@@ -105,7 +173,7 @@ void MemoryObjsCollector::dump() {
 
 // visitor
 void MemoryObjsCollector::CollectMemVisitor::operator()(NumberInst& i) {
-  // do nothing
+  constants.emplace(i.lv_name, i.val);
 }
 void MemoryObjsCollector::CollectMemVisitor::operator()(StringInst& i) {
   // do nothing
@@ -130,6 +198,7 @@ void MemoryObjsCollector::CollectMemVisitor::operator()(OpInst& i) {
 void MemoryObjsCollector::CollectMemVisitor::operator()(FunInst& i) {
   auto memname = i.lv_name + ".mem";
   this->cur_fun = i.lv_name;
+  this->cur_args = i.args;
   for (auto& inst : *i.body) {
     std::visit(*this, inst);
   }
@@ -159,9 +228,27 @@ void MemoryObjsCollector::CollectMemVisitor::insertAllocaInst(
 
 void MemoryObjsCollector::CollectMemVisitor::operator()(FcallInst& i) {
   if (i.fname == "delay") {
-    // how to track delay size in ssa !!!
-    // M.collectDelay(cur_fun, int delay_size)
-  }else {
+    M.collectDelay(cur_fun, i.lv_name);
+  } else if (i.fname == "cache_stale") {
+    M.collectCache(cur_fun, i.lv_name);
+  } else if (i.fname == "random" || i.fname == "urandom" ||
+             i.fname == "pinknoise") {
+    M.collectNoise(cur_fun, i.lv_name, i.fname == "pinknoise");
+  } else if (i.fname == "history") {
+    auto& var = i.args[0];
+    bool isarg = std::find(cur_args.begin(), cur_args.end(), var) !=
+                 cur_args.end();
+    if (var != "self" && !isarg) {
+      throw std::logic_error("history of \"" + var +
+                             "\" is not available, only self and arguments "
+                             "can be referred with [-n]");
+    }
+    auto length = constants.find(i.args[1]);
+    if (length == constants.end()) {
+      throw std::logic_error("the length of history is unknown at compile time");
+    }
+    M.collectHistory(cur_fun, i, static_cast<int>(length->second));
+  } else {
     M.collectMemFun(cur_fun, i.fname);
   }
   for (auto& a : i.args) {
@@ -174,12 +261,32 @@ void MemoryObjsCollector::CollectMemVisitor::operator()(FcallInst& i) {
 void MemoryObjsCollector::CollectMemVisitor::operator()(MakeClosureInst& i) {
   //??
 }
-void MemoryObjsCollector::CollectMemVisitor::operator()(ArrayInst& i) {}
+void MemoryObjsCollector::CollectMemVisitor::operator()(ArrayInst& i) {
+  M.collectArray(cur_fun, i);
+}
 void MemoryObjsCollector::CollectMemVisitor::operator()(ArrayAccessInst& i) {
   M.collectSelf(cur_fun, i.name);
   M.collectSelf(cur_fun, i.index);
 }
-void MemoryObjsCollector::CollectMemVisitor::operator()(IfInst& i) {}
+void MemoryObjsCollector::CollectMemVisitor::operator()(IfInst& i) {
+  M.collectSelf(cur_fun, i.cond);
+  for (auto& inst : *i.thenblock) {
+    std::visit(*this, inst);
+  }
+  for (auto& inst : *i.elseblock) {
+    std::visit(*this, inst);
+  }
+  if (i.isexpr) {
+    M.collectSelf(cur_fun, i.thenval);
+    M.collectSelf(cur_fun, i.elseval);
+  }
+}
+void MemoryObjsCollector::CollectMemVisitor::operator()(ForInst& i) {
+  M.collectSelf(cur_fun, i.count);
+  for (auto& inst : *i.body) {
+    std::visit(*this, inst);
+  }
+}
 void MemoryObjsCollector::CollectMemVisitor::operator()(ReturnInst& i) {
   M.collectSelf(cur_fun, i.val);
 }
@@ -19,6 +19,8 @@ class MemoryObjsCollector {
     return getAliasFromMap(fname).value();
   };
   auto& getMemObjNames(const std::string& fname) { return memobjs_map[fname]; };
+  // pairs of the name of history buffer and the value written to it
+  auto& getHistories(const std::string& fname) { return history_map[fname]; };
 
   void dump();
 
@@ -28,12 +30,19 @@ class MemoryObjsCollector {
 
   std::unordered_map<std::string, std::vector<std::string>> memobjs_map;
   std::unordered_map<std::string, types::Alias> type_alias_map;
+  std::unordered_map<std::string,
+                     std::vector<std::pair<std::string, std::string>>>
+      history_map;
   void emplaceNewAlias(std::string& name, types::Value type);
   std::optional<types::Alias> getAliasFromMap(std::string name);
 
   void collectSelf(std::string& funname, std::string& varname);
-  void collectDelay(std::string& funname, int delay_size);
+  void collectDelay(std::string& funname, std::string& name);
+  void collectCache(std::string& funname, std::string& name);
+  void collectNoise(std::string& funname, std::string& name, bool ispink);
+  void collectHistory(std::string& funname, FcallInst& i, int length);
   void collectMemPrim(std::string& funname, std::string& argname);
+  void collectArray(std::string& funname, ArrayInst& i);
 
   void collectMemFun(std::string& funname, std::string& varname);
   struct CollectMemVisitor {
@@ -54,11 +63,14 @@ class MemoryObjsCollector {
     void operator()(ArrayInst& i);
     void operator()(ArrayAccessInst& i);
     void operator()(IfInst& i);
+    void operator()(ForInst& i);
     void operator()(ReturnInst& i);
 
    private:
     void insertAllocaInst(FunInst& i, types::Alias& type);
     std::string cur_fun;
+    std::deque<std::string> cur_args;
+    std::unordered_map<std::string, double> constants;
   } cm_visitor;
 };
 
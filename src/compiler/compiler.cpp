@@ -11,8 +11,12 @@ Compiler::Compiler(llvm::LLVMContext& ctx)
       typevisitor(),
       recursivechecker(),
       knormvisitor(typevisitor),
+      partialevaluator(),
+      mathsimplifier(typevisitor.getEnv()),
       closureconverter(
           std::make_shared<ClosureConverter>(typevisitor.getEnv())),
+      tailcalloptimizer(),
+      rateanalyzer(typevisitor.getEnv()),
       memobjcollector(typevisitor.getEnv()),
       llvmgenerator(ctx, typevisitor.getEnv(),*closureconverter,memobjcollector) {}
 Compiler::~Compiler() = default;
@@ -46,11 +50,40 @@ std::shared_ptr<MIRblock> Compiler::generateMir(AST_Ptr ast) {
   ast->accept(knormvisitor);
   return knormvisitor.getResult();
 }
+std::shared_ptr<MIRblock> Compiler::partialEvaluate(
+    std::shared_ptr<MIRblock> mir) {
+  return partialevaluator.process(mir);
+}
+std::shared_ptr<MIRblock> Compiler::simplifyMath(
+    std::shared_ptr<MIRblock> mir) {
+  return mathsimplifier.process(mir);
+}
+void Compiler::setReciprocalMath(bool flag) {
+  mathsimplifier.setReciprocalMath(flag);
+}
+void Compiler::setFastMath(bool flag) { llvmgenerator.setFastMath(flag); }
+void Compiler::setApproxMath(bool flag) { mathsimplifier.setApproxMath(flag); }
+void Compiler::setRandomSeed(uint64_t seed) {
+  llvmgenerator.setRandomSeed(seed);
+}
+void Compiler::setSinglePrecision(bool flag) {
+  llvmgenerator.setSinglePrecision(flag);
+}
 std::shared_ptr<MIRblock> Compiler::closureConvert(
     std::shared_ptr<MIRblock> mir) {
   return closureconverter->convert(mir);
 }
 
+std::shared_ptr<MIRblock> Compiler::optimizeTailCalls(
+    std::shared_ptr<MIRblock> mir) {
+  return tailcalloptimizer.process(mir);
+}
+
+std::shared_ptr<MIRblock> Compiler::analyzeRate(
+    std::shared_ptr<MIRblock> mir) {
+  return rateanalyzer.process(mir);
+}
+
 std::shared_ptr<MIRblock> Compiler::collectMemoryObjs(
     std::shared_ptr<MIRblock> mir) {
   return memobjcollector.process(mir);
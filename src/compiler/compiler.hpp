@@ -13,8 +13,12 @@
 #include "compiler/recursive_checker.hpp"
 #include "compiler/type_infer_visitor.hpp"
 #include "compiler/knormalize_visitor.hpp"
+#include "compiler/partial_evaluator.hpp"
+#include "compiler/math_simplifier.hpp"
 #include "compiler/closure_convert.hpp"
 #include "compiler/collect_memoryobjs.hpp"
+#include "compiler/tailcall_optimizer.hpp"
+#include "compiler/rate_analyzer.hpp"
 #include "compiler/codegen/llvmgenerator.hpp"
 
 namespace mimium {
@@ -33,7 +37,16 @@ public:
     AST_Ptr alphaConvert(AST_Ptr ast);
     TypeEnv& typeInfer(AST_Ptr ast);
     std::shared_ptr<MIRblock> generateMir(AST_Ptr ast);
+    std::shared_ptr<MIRblock> partialEvaluate(std::shared_ptr<MIRblock> mir);
+    std::shared_ptr<MIRblock> simplifyMath(std::shared_ptr<MIRblock> mir);
+    void setReciprocalMath(bool flag);
+    void setFastMath(bool flag);
+    void setApproxMath(bool flag);
+    void setRandomSeed(uint64_t seed);
+    void setSinglePrecision(bool flag);
     std::shared_ptr<MIRblock> closureConvert(std::shared_ptr<MIRblock> mir);
+    std::shared_ptr<MIRblock> optimizeTailCalls(std::shared_ptr<MIRblock> mir);
+    std::shared_ptr<MIRblock> analyzeRate(std::shared_ptr<MIRblock> mir);
     std::shared_ptr<MIRblock> collectMemoryObjs(std::shared_ptr<MIRblock> mir);
 
     llvm::Module& generateLLVMIr(std::shared_ptr<MIRblock> mir);
@@ -45,7 +58,11 @@ public:
   TypeInferVisitor typevisitor;
   RecursiveChecker recursivechecker;
   KNormalizeVisitor knormvisitor;
+  PartialEvaluator partialevaluator;
+  MathSimplifier mathsimplifier;
   std::shared_ptr<ClosureConverter> closureconverter;
+  TailCallOptimizer tailcalloptimizer;
+  RateAnalyzer rateanalyzer;
   MemoryObjsCollector memobjcollector;
   LLVMGenerator llvmgenerator;
   std::string path;
@@ -65,6 +65,14 @@ std::shared_ptr<LvarAST> MimiumDriver::add_lvar(std::string str){
 std::shared_ptr<LvarAST> MimiumDriver::add_lvar(std::string str, mimium::types::Value type){
       return std::make_unique<LvarAST>(std::move(str),std::move(type));
 };
+std::shared_ptr<LvarAST> MimiumDriver::add_const_lvar(std::string str,const std::string& qualifier, mimium::types::Value type){
+   if(qualifier!="c"){
+      throw std::runtime_error("unknown type qualifier \""+qualifier+"\" for "+str);
+   }
+   auto res = std::make_shared<LvarAST>(std::move(str),std::move(type));
+   res->isconst = true;
+   return res;
+};
 
 
 std::shared_ptr<RvarAST> MimiumDriver::add_rvar(std::string str){
@@ -105,6 +113,17 @@ AST_Ptr MimiumDriver::add_lambda_only_with_returntype(std::shared_ptr<ArgumentsA
    mimium::types::Function ftype(std::move(rettype),{});
    return std::make_unique<LambdaAST>(std::move(args),std::move(body),std::move(ftype));
 }
+AST_Ptr MimiumDriver::set_fpmode(AST_Ptr lambda,const std::string& mode){
+   auto& ast = static_cast<LambdaAST&>(*lambda);
+   if(mode=="fast"){
+      ast.fpmode = FPMODE::FAST;
+   }else if(mode=="strict"){
+      ast.fpmode = FPMODE::STRICT;
+   }else{
+      throw std::runtime_error("unknown function attribute \""+mode+"\"");
+   }
+   return lambda;
+}
 
 
 
@@ -126,6 +145,18 @@ std::shared_ptr<ArrayAccessAST> MimiumDriver::add_array_access(std::shared_ptr<R
    return std::make_unique<ArrayAccessAST>(std::move(array),std::move(index));
 };
 
+std::shared_ptr<FcallAST> MimiumDriver::add_array_store(std::shared_ptr<ArrayAccessAST> access,AST_Ptr value){
+   auto args = add_fcallargs(std::move(value));
+   args->addAST(access->getIndex());
+   args->addAST(access->getName());
+   return add_fcall(add_rvar("array_store"),std::move(args));
+};
+std::shared_ptr<FcallAST> MimiumDriver::add_history(AST_Ptr var,double length){
+   auto args = add_fcallargs(add_number(length));
+   args->addAST(std::move(var));
+   return add_fcall(add_rvar("history"),std::move(args));
+};
+
 AST_Ptr MimiumDriver::add_return(AST_Ptr expr){
    return std::make_unique<ReturnAST>(std::move(expr));
 };
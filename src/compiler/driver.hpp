@@ -37,6 +37,10 @@ class MimiumDriver {
 
   std::shared_ptr<LvarAST> add_lvar(std::string str);
   std::shared_ptr<LvarAST> add_lvar(std::string str, mimium::types::Value type);
+  // "name:c:type", only "c" is accepted as a qualifier
+  std::shared_ptr<LvarAST> add_const_lvar(
+      std::string str, const std::string& qualifier,
+      mimium::types::Value type = mimium::types::Float());
 
   std::shared_ptr<RvarAST> add_rvar(std::string str);
   std::shared_ptr<SelfAST> add_self(std::string str);
@@ -54,6 +58,8 @@ class MimiumDriver {
   AST_Ptr add_lambda_only_with_returntype(std::shared_ptr<ArgumentsAST> args,
                                           AST_Ptr body,
                                           mimium::types::Value rettype);
+  // "fn f(x) fast {...}", only "fast" and "strict" are accepted
+  AST_Ptr set_fpmode(AST_Ptr lambda, const std::string& mode);
 
   std::shared_ptr<FcallAST> add_fcall(std::shared_ptr<AST> fname,
                                       std::shared_ptr<FcallArgsAST> args,std::shared_ptr<AST> time = nullptr);
@@ -67,6 +73,11 @@ class MimiumDriver {
   std::shared_ptr<ArrayAccessAST> add_array_access(
       std::shared_ptr<RvarAST>,
       AST_Ptr index);  // todo: is it better to use fcall as syntax sugar?
+  // arr[index] = value is a syntax sugar of array_store(arr,index,value)
+  std::shared_ptr<FcallAST> add_array_store(
+      std::shared_ptr<ArrayAccessAST> access, AST_Ptr value);
+  // self[-n] and arg[-n] are syntax sugar of history(var,n)
+  std::shared_ptr<FcallAST> add_history(AST_Ptr var, double length);
 
   AST_Ptr add_return(AST_Ptr expr);
   std::shared_ptr<AssignAST> add_assign(std::shared_ptr<LvarAST> symbol,
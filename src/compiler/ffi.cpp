@@ -4,6 +4,24 @@
  
 
 #include "compiler/ffi.hpp"
+namespace {
+// reads every frame of the file, or returns nullptr if it cannot be opened.
+template <typename T>
+T* loadSoundFile(char* filename,
+                 sf_count_t (*readframes)(SNDFILE*, T*, sf_count_t)) {
+    SF_INFO sfinfo;
+    auto* sfile = sf_open(filename, SFM_READ, &sfinfo);
+    if (sfile == nullptr) {
+        std::cerr << sf_strerror(sfile) << "\n";
+        return nullptr;
+    }
+    T* buffer = new T[sfinfo.frames * sfinfo.channels];
+    readframes(sfile, buffer, sfinfo.frames);
+    sf_close(sfile);
+    return buffer;
+}
+}  // namespace
+
 extern "C" {
 void dumpaddress(void* a) { std::cerr << a <<"\n"; }
 
@@ -12,8 +30,6 @@ void printlndouble(double d) { std::cerr << d << "\n"; }
 
 void printlnstr(char* str){ std::cerr << str << "\n"; }
 
-double mimiumrand(){return ((double)rand()/RAND_MAX)*2 -1  ;}
-
 double mimium_ifexpr(double cond,double thenval,double elseval){
     return (cond>0)?thenval:elseval;
 }
@@ -23,6 +39,9 @@ bool mimium_dtob(double d){
 int64_t mimium_dtoi(double d){
     return static_cast<int64_t>(d);
 }
+double mimium_itod(int64_t i){
+    return static_cast<double>(i);
+}
 double mimium_gt(double d1,double d2){
     return static_cast<double>(d1>d2);
 }
@@ -53,11 +72,16 @@ double mimium_memprim(double d,double* mem){
     *mem = d;
     return tmp;
 }
+float mimium_memprimf(float d,float* mem){
+    auto tmp = *mem;
+    *mem = d;
+    return tmp;
+}
 
 double access_array_lin_interp(double* array,double index_d){
     double fract = fmod(index_d,1.000);
     int64_t index= floor(index_d);
-    return array[index]*fract + array[index+1]*(1-fract);
+    return array[index]*(1-fract) + array[index+1]*fract;
 }
 
 double libsndfile_loadwavsize(char* filename){
@@ -72,18 +96,11 @@ double libsndfile_loadwavsize(char* filename){
 }
 
 double* libsndfile_loadwav(char* filename){
-    SF_INFO sfinfo;
-    auto sfile = sf_open(filename,SFM_READ,&sfinfo);
-    if(sfile==nullptr){
-        std::cerr << sf_strerror(sfile)<<"\n"; 
-    }
-    
-    const int bufsize = sfinfo.frames*sfinfo.channels;
-    double* buffer = new double[bufsize];
-    auto size = sf_readf_double(sfile,buffer,bufsize);
-    // sf_close(sfile);
-    // std::cerr<< filename << "(" << size << ") is succecfully loaded";
-    return buffer;
+    return loadSoundFile(filename, sf_readf_double);
+}
+// for single precision mode
+float* libsndfile_loadwavf(char* filename){
+    return loadSoundFile(filename, sf_readf_float);
 }
 
 }
@@ -112,11 +129,23 @@ std::unordered_map<std::string, BuiltinFnInfo> LLVMBuiltin::ftable = {
     {"tanh", FI{Function(Float(), {Float()}), "tanh"}},
 
     {"exp", FI{Function(Float(), {Float()}), "exp"}},
+    {"exp2", FI{Function(Float(), {Float()}), "exp2"}},
     {"pow", FI{Function(Float(), {Float(),Float()}), "pow"}},
 
+    // polynomial approximations, emitted inline by codegen.
+    {"fastsin", FI{Function(Float(), {Float()}), ""}},
+    {"fastcos", FI{Function(Float(), {Float()}), ""}},
+    {"fastexp", FI{Function(Float(), {Float()}), ""}},
+    {"fastpow2", FI{Function(Float(), {Float()}), ""}},
+    {"fasttanh", FI{Function(Float(), {Float()}), ""}},
+
     {"log", FI{Function(Float(), {Float()}), "log"}},
     {"log10", FI{Function(Float(), {Float()}), "log10"}},
-    {"random", FI{Function(Float(), {}), "mimiumrand"}},
+    // white noise in [-1,1), [0,1) and pink noise, emitted inline by codegen.
+    // the state of generator is held in memory object.
+    {"random", FI{Function(Float(), {}), ""}},
+    {"urandom", FI{Function(Float(), {}), ""}},
+    {"pinknoise", FI{Function(Float(), {}), ""}},
 
     {"sqrt", FI{Function(Float(), {Float()}), "sqrt"}},
     {"abs", FI{Function(Float(), {Float()}), "fabs"}},
@@ -141,6 +170,8 @@ std::unordered_map<std::string, BuiltinFnInfo> LLVMBuiltin::ftable = {
     {"or", FI{Function(Float(), {Float(),Float()}), "mimium_or"}},
     {"lshift", FI{Function(Float(), {Float(),Float()}), "mimium_lshift"}},
     {"rshift", FI{Function(Float(), {Float(),Float()}), "mimium_rshift"}},
+    {"itof", FI{Function(Float(), {Int()}), "mimium_itod"}},
+    {"ftoi", FI{Function(Int(), {Float()}), "mimium_dtoi"}},
     {"ifexpr", FI{Function(Float(), {Float(),Float(),Float()}), "mimium_ifexpr"}},
 
     {"mem", FI{Function(Float(), {Float()}), "mimium_memprim"}},
@@ -149,8 +180,34 @@ std::unordered_map<std::string, BuiltinFnInfo> LLVMBuiltin::ftable = {
 
     {"loadwav",FI{Function(Array(Float()),{String()}),"libsndfile_loadwav"}},
 
-    {"access_array_lin_interp", FI{Function(Float(), {Float(),Float()}), "access_array_lin_interp"}}
+    {"access_array_lin_interp", FI{Function(Float(), {Float(),Float()}), "access_array_lin_interp"}},
+    // delay(maxsize,input,time), ring buffer is held in memory object.
+    {"delay", FI{Function(Float(), {Float(),Float(),Float()}), ""}},
+    // history(var,n), written as self[-n] or arg[-n].
+    {"history", FI{Function(Float(), {Float(),Float()}), ""}},
+    // cache of event-rate values inserted by RateAnalyzer.
+    {"cache_stale", FI{Function(Int(), {}), ""}},
+    {"cache_invalidate", FI{Function(Void(), {}), ""}},
+    // arr[index] = value, emitted inline by codegen.
+    {"array_store", FI{Function(Void(), {Array(Float()),Float(),Float()}), ""}},
+
+    // vector constructors are emitted inline by codegen.
+    {"vec2", FI{Function(Vector(2), {Float(),Float()}), ""}},
+    {"vec4", FI{Function(Vector(4), {Float(),Float(),Float(),Float()}), ""}},
+    {"vec8", FI{Function(Vector(8), {Float(),Float(),Float(),Float(),
+                                     Float(),Float(),Float(),Float()}), ""}}
 
 };
+std::unordered_set<std::string> LLVMBuiltin::lanewise = {
+    "sin",   "cos",  "exp",   "exp2",  "log", "log10", "pow", "sqrt",
+    "abs",   "floor", "ceil", "trunc", "round", "min", "max",
+    "fastsin", "fastcos", "fastexp", "fastpow2", "fasttanh"};
+
+std::unordered_set<std::string> LLVMBuiltin::f32_variants = {
+    "sin",   "cos",   "tan",   "asin",      "acos", "atan",
+    "atan2", "sinh",  "cosh",  "tanh",      "exp",  "exp2",
+    "pow",   "log",   "log10", "sqrt",      "fabs", "ceil",
+    "floor", "trunc", "round", "fmod",      "fmin", "fmax",
+    "remainder",      "mimium_memprim",     "libsndfile_loadwav"};
 
 }  // namespace mimium
\ No newline at end of file
@@ -6,6 +6,7 @@
 #define LLVM_DISABLE_ABI_BREAKING_CHECKS_ENFORCING 1
 #include <initializer_list>
 #include <unordered_map>
+#include <unordered_set>
 
 // #include "compiler/runtime/mididriver.hpp"
 #include "basic/type.hpp"
@@ -27,6 +28,11 @@ struct BuiltinFnInfo {
 };
 struct LLVMBuiltin {
   static std::unordered_map<std::string, BuiltinFnInfo> ftable;
+  // builtins which also accept vector arguments and are applied lane-wise.
+  static std::unordered_set<std::string> lanewise;
+  // target functions which have single precision variant named with suffix
+  // "f", used in single precision mode.
+  static std::unordered_set<std::string> f32_variants;
   static bool isBuiltin(std::string fname) {
     return LLVMBuiltin::ftable.count(fname) > 0;
   }
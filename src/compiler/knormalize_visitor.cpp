@@ -44,11 +44,28 @@ void KNormalizeVisitor::visit(OpAST& ast) {
   auto nextlhs = stackPopStr();
   ast.rhs->accept(*this);
   auto nextrhs = stackPopStr();
-  Instructions newinst =
-      OpInst(name, ast.getOpStr(), std::move(nextlhs), std::move(nextrhs));
+  // both operands have the same type after type inference, except for a
+  // scalar operand broadcasted to vector.
+  auto type = getNumericType(nextlhs);
+  auto rhstype = getNumericType(nextrhs);
+  if (std::holds_alternative<types::Vector>(rhstype)) {
+    type = rhstype;
+  }
+  Instructions newinst = OpInst(name, ast.getOpStr(), std::move(nextlhs),
+                                std::move(nextrhs), type);
   currentblock->addInst(newinst);
   res_stack_str.push(name);
-  typeinfer.getEnv().emplace(name, types::Float());
+  typeinfer.getEnv().emplace(name, type);
+}
+// Int, Vector or Float, the type of arithmetic operands, if conditions and
+// loop counts
+types::Value KNormalizeVisitor::getNumericType(const std::string& name) {
+  auto* type = typeinfer.getEnv().tryFind(name);
+  if (type != nullptr && (std::holds_alternative<types::Int>(*type) ||
+                          std::holds_alternative<types::Vector>(*type))) {
+    return *type;
+  }
+  return types::Float();
 }
 void KNormalizeVisitor::insertOverWrite(AST_Ptr body, const std::string& name) {
   body->accept(*this);
@@ -88,7 +105,14 @@ void KNormalizeVisitor::visit(AssignAST& ast) {
   } else {
     switch (body->getid()) {
       case RVAR:
-        insertRef(body, name);
+        if (types::isPrimitive(type)) {
+          // primitive values are simply copied, so that the variable can be
+          // overwritten later(e.g. in branches of if statement).
+          insertAlloca(body, name);
+          insertOverWrite(body, name);
+        } else {
+          insertRef(body, name);
+        }
         break;
       case SELF:
         insertAlloca(body, name);
@@ -112,10 +136,10 @@ void KNormalizeVisitor::visit(AssignAST& ast) {
 
 void KNormalizeVisitor::visit(NumberAST& ast) {
   auto name = getVarName();
-  Instructions newinst = NumberInst(name, ast.getVal());
+  Instructions newinst = NumberInst(name, ast.getVal(), ast.type);
   currentblock->addInst(newinst);
   res_stack_str.push(name);
-  typeinfer.getEnv().emplace(name, types::Float());
+  typeinfer.getEnv().emplace(name, ast.type);
 }
 void KNormalizeVisitor::visit(StringAST& ast) {
   auto name = getVarName();
@@ -151,6 +175,11 @@ void KNormalizeVisitor::visit(LambdaAST& ast) {
   typeinfer.getEnv().emplace(name, type_stack.top());
 
   newinst.hasself = ast.hasself;
+  auto tmpfpmode = current_fpmode;
+  if (ast.fpmode != FPMODE::DEFAULT) {
+    current_fpmode = ast.fpmode;
+  }
+  newinst.fpmode = current_fpmode;
   Instructions res = newinst;
   ++currentblock->indent_level;
   currentblock->addInst(res);
@@ -158,6 +187,7 @@ void KNormalizeVisitor::visit(LambdaAST& ast) {
   currentblock = newinst.body;  // move context
   ast.getBody()->accept(*this);
   currentblock = tmpcontext;  // switch back context
+  current_fpmode = tmpfpmode;
   --currentblock->indent_level;
   res_stack_str.push(name);
 }
@@ -182,6 +212,24 @@ void KNormalizeVisitor::visit(LambdaAST& ast) {
 //   return res;
 // }
 void KNormalizeVisitor::visit(FcallAST& ast) {
+  if (TypeInferVisitor::isArrayConstructor(ast)) {
+    auto newname = getVarName();
+    ArrayInst newinst(newname,
+                      TypeInferVisitor::getArrayConstructorSize(ast));
+    typeinfer.getEnv().emplace(newname, newinst.type);
+    Instructions res = newinst;
+    currentblock->addInst(res);
+    res_stack_str.push(newname);
+    return;
+  }
+  if (TypeInferVisitor::isArrayLookup(ast)) {
+    insertArrayLookup(ast);
+    return;
+  }
+  if (TypeInferVisitor::isDelay(ast)) {
+    insertDelay(ast);
+    return;
+  }
   ast.getFname()->accept(*this);
   auto resfname = stackPopStr();
   auto newname = getVarName();
@@ -219,14 +267,15 @@ void KNormalizeVisitor::visit(FcallAST& ast) {
 void KNormalizeVisitor::visit(FcallArgsAST& ast) {}
 void KNormalizeVisitor::visit(ArgumentsAST& ast) {}
 void KNormalizeVisitor::visit(ArrayAST& ast) {
+  auto newname = getVarName();
   std::deque<std::string> newelem;
   for (auto& elem : ast.getElements()) {
     elem->accept(*this);
     newelem.push_back(stackPopStr());
   }
-  auto newname = getVarName();
 
   ArrayInst newinst(newname, std::move(newelem));
+  typeinfer.getEnv().emplace(newname, newinst.type);
   Instructions res = newinst;
   currentblock->addInst(res);
   res_stack_str.push(newname);
@@ -237,24 +286,85 @@ void KNormalizeVisitor::visit(ArrayAccessAST& ast) {  // access index may be
   ast.getIndex()->accept(*this);
 
   ArrayAccessInst newinst(newname, ast.getName()->getVal(), stackPopStr());
+  typeinfer.getEnv().emplace(newname, types::Float());
   Instructions res = newinst;
 
   currentblock->addInst(res);
   res_stack_str.push(newname);
 }
+void KNormalizeVisitor::insertArrayLookup(FcallAST& ast) {
+  auto newname = getVarName();
+  auto args = ast.getArgs()->getElements();
+  auto getmode = [&](size_t pos, auto& table, auto defaultmode) {
+    if (args.size() <= pos) {
+      return defaultmode;
+    }
+    auto* str = dynamic_cast<StringAST*>(args[pos].get());
+    if (str == nullptr || table.count(str->val) == 0) {
+      throw std::logic_error("invalid mode for lookup()");
+    }
+    return table.at(str->val);
+  };
+  auto interp = getmode(2, interp_table, INTERP::LINEAR);
+  auto boundary = getmode(3, boundary_table, BOUNDARY::CLAMP);
+  args[0]->accept(*this);
+  auto arrname = stackPopStr();
+  args[1]->accept(*this);
+  ArrayAccessInst newinst(newname, arrname, stackPopStr(), interp, boundary);
+  typeinfer.getEnv().emplace(newname, types::Float());
+  Instructions res = newinst;
+  currentblock->addInst(res);
+  res_stack_str.push(newname);
+}
+// delay(maxsize,input,time) uses Array for its ring buffer, which becomes a
+// part of memory object. The length is a power of two larger than maxsize+1
+// so that the read position of interpolation can be wrapped by bitmask.
+void KNormalizeVisitor::insertDelay(FcallAST& ast) {
+  auto newname = getVarName();
+  auto maxsize = TypeInferVisitor::getDelayMaxSize(ast);
+  int bufsize = 1;
+  while (bufsize < maxsize + 2) {
+    bufsize <<= 1;
+  }
+  auto bufname = newname + "$buf";
+  ArrayInst buf(bufname, bufsize);
+  typeinfer.getEnv().emplace(bufname, buf.type);
+  Instructions bufinst = buf;
+  currentblock->addInst(bufinst);
+  auto args = ast.getArgs()->getElements();
+  args[1]->accept(*this);
+  auto input = stackPopStr();
+  args[2]->accept(*this);
+  auto time = stackPopStr();
+  Instructions newinst =
+      FcallInst(newname, "delay", {bufname, input, time}, EXTERNAL);
+  currentblock->addInst(newinst);
+  typeinfer.getEnv().emplace(newname, types::Float());
+  res_stack_str.push(newname);
+}
 void KNormalizeVisitor::visit(IfAST& ast) {
   auto tmpcontext = currentblock;
   auto newname = getVarName();
   ast.getCond()->accept(*this);
   auto condname = stackPopStr();
-  ast.getThen()->accept(*this);
-  auto thenval = stackPopStr();
-  ast.getElse()->accept(*this);
-  auto elseval = stackPopStr();
   if (ast.isexpr) {
-    Instructions res =
-        FcallInst(newname, "ifexpr", {condname, thenval, elseval}, EXTERNAL);
+    // each branch is evaluated lazily inside its own block
+    IfInst newinst(newname, condname, true);
+    currentblock->indent_level++;
+    newinst.thenblock->indent_level = currentblock->indent_level;
+    newinst.elseblock->indent_level = currentblock->indent_level;
+    currentblock = newinst.thenblock;
+    ast.getThen()->accept(*this);
+    newinst.thenval = stackPopStr();
+    currentblock = newinst.elseblock;
+    ast.getElse()->accept(*this);
+    newinst.elseval = stackPopStr();
+    currentblock = tmpcontext;
+    currentblock->indent_level--;
+    newinst.type = getNumericType(newinst.thenval);
+    Instructions res = newinst;
     currentblock->addInst(res);
+    typeinfer.getEnv().emplace(newname, newinst.type);
     res_stack_str.push(newname);
   } else {
     IfInst newinst(newname, condname);
@@ -265,8 +375,10 @@ void KNormalizeVisitor::visit(IfAST& ast) {
     currentblock->addInst(res);
     currentblock = newinst.thenblock;
     ast.getThen()->accept(*this);
-    currentblock = newinst.elseblock;
-    ast.getElse()->accept(*this);
+    if (ast.getElse() != nullptr) {
+      currentblock = newinst.elseblock;
+      ast.getElse()->accept(*this);
+    }
     res_stack_str.push(newname);
     currentblock = tmpcontext;
     currentblock->indent_level--;
@@ -282,7 +394,22 @@ void KNormalizeVisitor::visit(ReturnAST& ast) {
   currentblock->addInst(newinst);
 }
 void KNormalizeVisitor::visit(ForAST& ast) {
-  //後回し
+  auto tmpcontext = currentblock;
+  auto newname = getVarName();
+  ast.getIterator()->accept(*this);
+  auto countname = stackPopStr();
+  ast.getVar()->accept(*this);
+  auto varname = stackPopStr();
+  typeinfer.getEnv().emplace(varname, getNumericType(countname));
+  ForInst newinst(newname, varname, countname);
+  Instructions res = newinst;
+  currentblock->indent_level++;
+  newinst.body->indent_level = currentblock->indent_level;
+  currentblock->addInst(res);
+  currentblock = newinst.body;
+  ast.getExpression()->accept(*this);
+  currentblock = tmpcontext;
+  currentblock->indent_level--;
 }
 void KNormalizeVisitor::visit(DeclarationAST& ast) {
   current_context->appendAST(std::make_unique<DeclarationAST>(ast));
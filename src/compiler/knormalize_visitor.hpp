@@ -47,12 +47,16 @@ class KNormalizeVisitor : public ASTVisitor {
   std::shared_ptr<MIRblock> rootblock;
   std::shared_ptr<MIRblock> currentblock;
   int var_counter;
+  FPMODE current_fpmode = FPMODE::DEFAULT;  // inherited by nested lambdas
   std::string makeNewName();
   std::string getVarName();
   bool isArgTime(FcallArgsAST& args);
   std::string tmpname;
   std::shared_ptr<ListAST> current_context;
   AST_Ptr insertAssign(AST_Ptr ast);
+  types::Value getNumericType(const std::string& name);
+  void insertArrayLookup(FcallAST& ast);
+  void insertDelay(FcallAST& ast);
   void insertOverWrite(AST_Ptr body, const std::string& name);
   void insertAlloca(AST_Ptr body, const std::string& name);
   void insertRef(AST_Ptr body, const std::string& name);
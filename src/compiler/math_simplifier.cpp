@@ -0,0 +1,185 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "compiler/math_simplifier.hpp"
+
+#include <cmath>
+
+#include "compiler/ffi.hpp"
+namespace mimium {
+
+// libm function name to the name of approximated builtin.
+const std::unordered_map<std::string, std::string>
+    MathSimplifier::approx_builtins = {{"sin", "fastsin"},
+                                       {"cos", "fastcos"},
+                                       {"exp", "fastexp"},
+                                       {"exp2", "fastpow2"},
+                                       {"tanh", "fasttanh"}};
+
+std::shared_ptr<MIRblock> MathSimplifier::process(
+    std::shared_ptr<MIRblock> toplevel) {
+  collect(*toplevel);
+  simplifyBlock(*toplevel);
+  return toplevel;
+}
+
+void MathSimplifier::collect(MIRblock& block) {
+  for (auto& inst : block) {
+    std::visit(overloaded{[&](AssignInst& i) { assigned.emplace(i.lv_name); },
+                          [&](FunInst& i) { collect(*i.body); },
+                          [&](IfInst& i) {
+                            collect(*i.thenblock);
+                            collect(*i.elseblock);
+                          },
+                          [&](ForInst& i) { collect(*i.body); },
+                          [](auto& i) {}},
+               inst);
+  }
+}
+
+std::optional<double> MathSimplifier::getConstant(const std::string& name) {
+  auto it = constants.find(name);
+  if (it == constants.end() || assigned.count(name) > 0) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+bool MathSimplifier::allowReciprocal() const {
+  return fpmode == FPMODE::FAST ||
+         (fpmode == FPMODE::DEFAULT && reciprocal_math);
+}
+
+bool MathSimplifier::isBuiltin(FcallInst& i, const std::string& target) {
+  if (i.ftype != EXTERNAL) {
+    return false;
+  }
+  auto it = LLVMBuiltin::ftable.find(i.fname);
+  return it != LLVMBuiltin::ftable.end() && it->second.target_fnname == target;
+}
+
+std::string MathSimplifier::insertNumber(MIRblock& block,
+                                         std::list<Instructions>::iterator pos,
+                                         const std::string& name, double val) {
+  NumberInst num(name, val);
+  num.parent = block.shared_from_this();
+  block.instructions.insert(pos, num);
+  typeenv.emplace(name, types::Float());
+  constants.emplace(name, val);
+  return name;
+}
+
+std::string MathSimplifier::insertCall(MIRblock& block,
+                                       std::list<Instructions>::iterator pos,
+                                       const std::string& name,
+                                       const std::string& fname,
+                                       const std::string& arg) {
+  FcallInst fcall(name, fname, {arg}, EXTERNAL);
+  fcall.parent = block.shared_from_this();
+  block.instructions.insert(pos, fcall);
+  typeenv.emplace(name, types::Float());
+  return name;
+}
+
+std::optional<Instructions> MathSimplifier::simplifyPow(
+    const MIRinstruction& i, const std::string& base,
+    const std::string& exponent) {
+  std::optional<Instructions> res;
+  auto b = getConstant(base);
+  auto e = getConstant(exponent);
+  if (b && b.value() == 2.0) {
+    res = FcallInst(i.lv_name, "exp2", {exponent}, EXTERNAL);
+  } else if (e && e.value() == 2.0) {
+    res = OpInst(i.lv_name, "*", base, base);
+  } else if (e && e.value() == 0.5 && allowReciprocal()) {
+    res = FcallInst(i.lv_name, "sqrt", {base}, EXTERNAL);
+  }
+  return res;
+}
+
+void MathSimplifier::simplifyBlock(MIRblock& block) {
+  auto& insts = block.instructions;
+  for (auto it = insts.begin(); it != insts.end(); ++it) {
+    std::optional<Instructions> newinst;
+    if (auto* num = std::get_if<NumberInst>(&*it)) {
+      constants.emplace(num->lv_name, num->val);
+    } else if (auto* op = std::get_if<OpInst>(&*it)) {
+      if (!std::holds_alternative<types::Float>(op->type)) {
+        continue;
+      }
+      auto rhs = getConstant(op->rhs);
+      switch (op->getOPid()) {
+        case OP_ID::EXP:
+          newinst = simplifyPow(*op, op->lhs, op->rhs);
+          break;
+        case OP_ID::DIV: {
+          if (!rhs || rhs.value() == 0.0) {
+            break;
+          }
+          int exponent;
+          // reciprocal of power of two is exact
+          bool isexact = std::frexp(rhs.value(), &exponent) == 0.5 ||
+                         std::frexp(rhs.value(), &exponent) == -0.5;
+          if (isexact || allowReciprocal()) {
+            auto recip = insertNumber(block, it, op->lv_name + "$recip",
+                                      1.0 / rhs.value());
+            newinst = OpInst(op->lv_name, "*", op->lhs, recip);
+          }
+          break;
+        }
+        case OP_ID::MOD:
+          if (rhs && rhs.value() == 1.0 && fpmode != FPMODE::STRICT) {
+            auto trunc =
+                insertCall(block, it, op->lv_name + "$trunc", "trunc", op->lhs);
+            newinst = OpInst(op->lv_name, "-", op->lhs, trunc);
+          }
+          break;
+        default:
+          break;
+      }
+    } else if (auto* fcall = std::get_if<FcallInst>(&*it)) {
+      if (fcall->time) {
+        continue;
+      }
+      auto& args = fcall->args;
+      bool isbinary = args.size() == 2 &&
+                      std::holds_alternative<types::Float>(fcall->type);
+      if (isbinary && isBuiltin(*fcall, "pow")) {
+        newinst = simplifyPow(*fcall, args[0], args[1]);
+      } else if (isbinary && isBuiltin(*fcall, "fmod") &&
+                 fpmode != FPMODE::STRICT) {
+        auto rhs = getConstant(args[1]);
+        if (rhs && rhs.value() == 1.0) {
+          auto trunc = insertCall(block, it, fcall->lv_name + "$trunc",
+                                  "trunc", args[0]);
+          newinst = OpInst(fcall->lv_name, "-", args[0], trunc);
+        }
+      } else if (approx_math && fpmode != FPMODE::STRICT) {
+        for (auto& [target, approx] : approx_builtins) {
+          if (isBuiltin(*fcall, target)) {
+            fcall->fname = approx;
+            break;
+          }
+        }
+      }
+    } else if (auto* fun = std::get_if<FunInst>(&*it)) {
+      auto tmpfpmode = fpmode;
+      fpmode = fun->fpmode;
+      simplifyBlock(*fun->body);
+      fpmode = tmpfpmode;
+    } else if (auto* ifinst = std::get_if<IfInst>(&*it)) {
+      simplifyBlock(*ifinst->thenblock);
+      simplifyBlock(*ifinst->elseblock);
+    } else if (auto* forinst = std::get_if<ForInst>(&*it)) {
+      simplifyBlock(*forinst->body);
+    }
+    if (newinst) {
+      auto parent = std::visit([](auto& i) { return i.parent; }, *it);
+      std::visit([&](auto& i) { i.setParent(parent); }, newinst.value());
+      *it = std::move(newinst.value());
+    }
+  }
+}
+
+}  // namespace mimium
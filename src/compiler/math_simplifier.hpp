@@ -0,0 +1,61 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+#include <set>
+
+#include "basic/mir.hpp"
+namespace mimium {
+
+// Rewrites calls of math builtins and arithmetics whose operands are constant
+// or of a known shape into cheaper ones. Builtins are identified by their
+// target function in LLVMBuiltin::ftable, so that user functions which shadow
+// the builtin names are not touched.
+//   pow(2,x), 2^x -> exp2(x)
+//   pow(x,2), x^2 -> x*x
+//   pow(x,0.5), x^0.5 -> sqrt(x)  if reciprocal math is allowed (differs
+//                                 for -0 and -inf)
+//   x/c -> x*(1/c)  if 1/c is exact or reciprocal math is allowed
+//   fmod(x,1), x%1 -> x-trunc(x)  except in "strict" functions (differs
+//                                  only in the sign of zero results)
+// Reciprocal math is always allowed in "fast" functions and never in
+// "strict" ones.
+// With approximate math, sin, cos, exp, exp2 and tanh are replaced with
+// fastsin, fastcos, fastexp, fastpow2 and fasttanh except in "strict"
+// functions.
+class MathSimplifier {
+ public:
+  explicit MathSimplifier(TypeEnv& typeenv) : typeenv(typeenv){};
+  std::shared_ptr<MIRblock> process(std::shared_ptr<MIRblock> toplevel);
+  void setReciprocalMath(bool flag) { reciprocal_math = flag; }
+  void setApproxMath(bool flag) { approx_math = flag; }
+
+ private:
+  TypeEnv& typeenv;
+  bool reciprocal_math = false;
+  bool approx_math = false;
+  const static std::unordered_map<std::string, std::string> approx_builtins;
+  FPMODE fpmode = FPMODE::DEFAULT;  // of the function being simplified
+  bool allowReciprocal() const;
+  std::set<std::string> assigned;
+  std::unordered_map<std::string, double> constants;
+
+  void collect(MIRblock& block);
+  void simplifyBlock(MIRblock& block);
+  std::optional<double> getConstant(const std::string& name);
+  static bool isBuiltin(FcallInst& i, const std::string& target);
+  // returns the name of the value inserted before the position
+  std::string insertNumber(MIRblock& block,
+                           std::list<Instructions>::iterator pos,
+                           const std::string& name, double val);
+  std::string insertCall(MIRblock& block,
+                         std::list<Instructions>::iterator pos,
+                         const std::string& name, const std::string& fname,
+                         const std::string& arg);
+  std::optional<Instructions> simplifyPow(const MIRinstruction& i,
+                                          const std::string& base,
+                                          const std::string& exponent);
+};
+
+}  // namespace mimium
@@ -94,6 +94,7 @@ using namespace mimium;
 
    TYPE_DELIM ":"
    TYPEFLOAT "typeid:float"
+   TYPEINT "typeid:int"
    TYPEVOID "typeid:void"
    TYPEFN "typeid:fn"
 
@@ -107,6 +108,7 @@ using namespace mimium;
 ;
 // %token <double> NOW "now_token"
 %token <double> NUM "number_token"
+%token <int> TYPEVEC "typeid:vector"
 %token  <std::string> SYMBOL "symbol_token"
 %token <std::string>    SELF "self_token"
 %token  <std::string> STRING "string_token"
@@ -156,6 +158,7 @@ using namespace mimium;
 %type <std::shared_ptr<ArrayAST>> array "array"
 %type <std::shared_ptr<ArrayAST>> array_elems "array elements"
 %type <std::shared_ptr<ArrayAccessAST>> array_access "array access"
+%type <AST_Ptr> history "history access"
 
 
 %type <std::shared_ptr<AssignAST>> assign "assign"
@@ -227,6 +230,7 @@ statement : assign {$$=std::move($1);}
          | fdef  {$$=std::move($1);} 
          | ifstatement  {$$=std::move($1);} 
          | forloop {$$=std::move($1);}
+         | array_access ASSIGN expr {$$ = driver.add_array_store(std::move($1),std::move($3));}
          | declaration {$$=std::move($1);} 
          |RETURN expr {$$ = driver.add_return(std::move($2));}
          | expr {$$ = std::move($1);}//for void function
@@ -235,7 +239,9 @@ statement : assign {$$=std::move($1);}
 assign : lvar ASSIGN expr {$$ = driver.add_assign(std::move($1),std::move($3));}
 
 fdef : FUNC fname arguments_top block {$$ = driver.add_assign(std::move($2),driver.add_lambda(std::move($3),std::move($4)));}
-      |FUNC fname arguments_top ARROW types block {$$ = driver.add_assign(std::move($2),driver.add_lambda_only_with_returntype(std::move($3),std::move($6),std::move($5)));};
+      |FUNC fname arguments_top ARROW types block {$$ = driver.add_assign(std::move($2),driver.add_lambda_only_with_returntype(std::move($3),std::move($6),std::move($5)));}
+      |FUNC fname arguments_top SYMBOL block {$$ = driver.add_assign(std::move($2),driver.set_fpmode(driver.add_lambda(std::move($3),std::move($5)),$4));}
+      |FUNC fname arguments_top SYMBOL ARROW types block {$$ = driver.add_assign(std::move($2),driver.set_fpmode(driver.add_lambda_only_with_returntype(std::move($3),std::move($7),std::move($6)),$4));};
 
 fname : SYMBOL {$$ = driver.add_lvar($1);}
 
@@ -286,6 +292,7 @@ term :
       fcall {$$ = std::move($1);}
       |array {$$ = std::move($1);}
       |array_access {$$ = std::move($1);}
+      |history {$$ = std::move($1);}
       |lambda {$$ = std::move($1);}
       |ifexpr {$$ = std::move($1);}
       |single {$$ = std::move($1);}
@@ -311,6 +318,9 @@ array_elems : single ',' array_elems   {$3->addAST(std::move($1));
          |  single {$$ = driver.add_array(std::move($1));}
 array_access: rvar '[' term ']' {$$ = driver.add_array_access(std::move($1),std::move($3));}
 
+history: self '[' SUB NUM ']' {$$ = driver.add_history(std::move($1),$4);}
+       | rvar '[' SUB NUM ']' {$$ = driver.add_history(std::move($1),$4);}
+
 lambda: OR arguments OR block {$$ = driver.add_lambda(std::move($2),std::move($4));};
       |OR arguments OR expr {$$ = driver.add_lambda(std::move($2),std::move($4));};
        |OR arguments OR ARROW types block{$$=driver.add_lambda_only_with_returntype(std::move($2),std::move($6),std::move($5));};
@@ -337,6 +347,8 @@ num :NUM {$$ = driver.add_number($1);}
 
 lvar : SYMBOL {$$ = driver.add_lvar($1);}
       |SYMBOL TYPE_DELIM types {$$ = driver.add_lvar($1,$3);}
+      |SYMBOL TYPE_DELIM SYMBOL {$$ = driver.add_const_lvar($1,$3);}
+      |SYMBOL TYPE_DELIM SYMBOL TYPE_DELIM types {$$ = driver.add_const_lvar($1,$3,$5);}
 
 self : SELF {$$ = driver.add_self($1);}
 
@@ -349,6 +361,8 @@ types : reftype{ $$=std::move($1);}
       | type_primitive{ $$=std::move($1);}
 
 type_primitive : TYPEFLOAT {$$ =mimium::types::Float();}
+               | TYPEINT {$$ =mimium::types::Int();}
+               | TYPEVEC {$$ =mimium::types::Vector($1);}
                | TYPEVOID  {$$ = mimium::types::Void();}
 reftype : types AND{
       mimium::types::Value v = mimium::types::Ref(std::move($1));
@@ -0,0 +1,321 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "compiler/partial_evaluator.hpp"
+
+#include <cmath>
+#include <limits>
+namespace mimium {
+namespace {
+using Args = const std::vector<double>&;
+double toBool(double d) { return static_cast<double>(d > 0); }
+}  // namespace
+
+// builtins without side effect, evaluated with the same semantics as runtime.
+const std::unordered_map<std::string,
+                         std::function<double(const std::vector<double>&)>>
+    PartialEvaluator::pure_builtins = {
+        {"sin", [](Args a) { return std::sin(a[0]); }},
+        {"cos", [](Args a) { return std::cos(a[0]); }},
+        {"tan", [](Args a) { return std::tan(a[0]); }},
+        {"asin", [](Args a) { return std::asin(a[0]); }},
+        {"acos", [](Args a) { return std::acos(a[0]); }},
+        {"atan", [](Args a) { return std::atan(a[0]); }},
+        {"atan2", [](Args a) { return std::atan2(a[0], a[1]); }},
+        {"sinh", [](Args a) { return std::sinh(a[0]); }},
+        {"cosh", [](Args a) { return std::cosh(a[0]); }},
+        {"tanh", [](Args a) { return std::tanh(a[0]); }},
+        {"exp", [](Args a) { return std::exp(a[0]); }},
+        {"exp2", [](Args a) { return std::exp2(a[0]); }},
+        {"pow", [](Args a) { return std::pow(a[0], a[1]); }},
+        // approximations are folded into the exact values.
+        {"fastsin", [](Args a) { return std::sin(a[0]); }},
+        {"fastcos", [](Args a) { return std::cos(a[0]); }},
+        {"fastexp", [](Args a) { return std::exp(a[0]); }},
+        {"fastpow2", [](Args a) { return std::exp2(a[0]); }},
+        {"fasttanh", [](Args a) { return std::tanh(a[0]); }},
+        {"log", [](Args a) { return std::log(a[0]); }},
+        {"log10", [](Args a) { return std::log10(a[0]); }},
+        {"sqrt", [](Args a) { return std::sqrt(a[0]); }},
+        {"abs", [](Args a) { return std::fabs(a[0]); }},
+        {"ceil", [](Args a) { return std::ceil(a[0]); }},
+        {"floor", [](Args a) { return std::floor(a[0]); }},
+        {"trunc", [](Args a) { return std::trunc(a[0]); }},
+        {"round", [](Args a) { return std::round(a[0]); }},
+        {"fmod", [](Args a) { return std::fmod(a[0], a[1]); }},
+        {"remainder", [](Args a) { return std::remainder(a[0], a[1]); }},
+        {"min", [](Args a) { return std::fmin(a[0], a[1]); }},
+        {"max", [](Args a) { return std::fmax(a[0], a[1]); }},
+        {"ge", [](Args a) { return static_cast<double>(a[0] >= a[1]); }},
+        {"le", [](Args a) { return static_cast<double>(a[0] <= a[1]); }},
+        {"gt", [](Args a) { return static_cast<double>(a[0] > a[1]); }},
+        {"lt", [](Args a) { return static_cast<double>(a[0] < a[1]); }},
+        {"and", [](Args a) { return toBool(a[0]) * toBool(a[1]); }},
+        {"or", [](Args a) { return std::fmax(toBool(a[0]), toBool(a[1])); }},
+        {"itof", [](Args a) { return a[0]; }},
+        {"ftoi", [](Args a) { return std::trunc(a[0]); }},
+        {"ifexpr", [](Args a) { return a[0] > 0 ? a[1] : a[2]; }}};
+
+std::shared_ptr<MIRblock> PartialEvaluator::process(
+    std::shared_ptr<MIRblock> toplevel) {
+  collect(*toplevel);
+  foldBlock(*toplevel);
+  return toplevel;
+}
+
+void PartialEvaluator::collect(MIRblock& block) {
+  for (auto& inst : block) {
+    std::visit(overloaded{[&](AssignInst& i) { assigned.emplace(i.lv_name); },
+                          [&](FunInst& i) {
+                            functions.emplace(i.lv_name, &i);
+                            collect(*i.body);
+                          },
+                          [&](IfInst& i) {
+                            collect(*i.thenblock);
+                            collect(*i.elseblock);
+                          },
+                          [&](ForInst& i) { collect(*i.body); },
+                          [](auto& i) {}},
+               inst);
+  }
+}
+
+void PartialEvaluator::replaceWithNumber(Instructions& inst,
+                                         MIRinstruction& i, double val) {
+  NumberInst newinst(i.lv_name, val, i.type);
+  newinst.parent = i.parent;
+  if (assigned.count(i.lv_name) == 0) {
+    constants.emplace(i.lv_name, val);
+  }
+  inst = std::move(newinst);
+}
+
+void PartialEvaluator::foldBlock(MIRblock& block) {
+  for (auto& inst : block) {
+    if (auto* num = std::get_if<NumberInst>(&inst)) {
+      if (assigned.count(num->lv_name) == 0) {
+        constants.emplace(num->lv_name, num->val);
+      }
+    } else if (auto* op = std::get_if<OpInst>(&inst)) {
+      auto lhs = lookup(op->lhs, constants);
+      auto rhs = lookup(op->rhs, constants);
+      if (lhs && rhs) {
+        if (auto res = evalOp(*op, lhs.value(), rhs.value())) {
+          replaceWithNumber(inst, *op, res.value());
+        }
+      }
+    } else if (auto* fcall = std::get_if<FcallInst>(&inst)) {
+      std::vector<double> args;
+      for (auto& a : fcall->args) {
+        if (auto v = lookup(a, constants)) {
+          args.push_back(v.value());
+        }
+      }
+      if (args.size() != fcall->args.size() || fcall->time) {
+        continue;
+      }
+      steps = 0;
+      if (auto res = evalCall(*fcall, args)) {
+        replaceWithNumber(inst, *fcall, res.value());
+      }
+    } else if (auto* fun = std::get_if<FunInst>(&inst)) {
+      foldBlock(*fun->body);
+    } else if (auto* ifinst = std::get_if<IfInst>(&inst)) {
+      foldBlock(*ifinst->thenblock);
+      foldBlock(*ifinst->elseblock);
+    } else if (auto* forinst = std::get_if<ForInst>(&inst)) {
+      foldBlock(*forinst->body);
+    }
+  }
+}
+
+std::optional<double> PartialEvaluator::lookup(const std::string& name,
+                                               Env& env) {
+  auto it = env.find(name);
+  if (it != env.end()) {
+    return it->second;
+  }
+  auto c = constants.find(name);
+  if (c != constants.end()) {
+    return c->second;
+  }
+  return std::nullopt;
+}
+
+std::optional<double> PartialEvaluator::evalOp(OpInst& i, double lhs,
+                                               double rhs) {
+  bool isint = std::holds_alternative<types::Int>(i.type);
+  if (!isint && !std::holds_alternative<types::Float>(i.type)) {
+    return std::nullopt;  // vector
+  }
+  auto l = static_cast<int64_t>(lhs);
+  auto r = static_cast<int64_t>(rhs);
+  switch (i.getOPid()) {
+    case OP_ID::ADD:
+      return lhs + rhs;
+    case OP_ID::SUB:
+      return lhs - rhs;
+    case OP_ID::MUL:
+      return lhs * rhs;
+    case OP_ID::DIV:
+      if (isint) {
+        return (r == 0) ? std::nullopt
+                        : std::optional<double>(static_cast<double>(l / r));
+      }
+      return lhs / rhs;
+    case OP_ID::MOD:
+      if (isint) {
+        return (r == 0) ? std::nullopt
+                        : std::optional<double>(static_cast<double>(l % r));
+      }
+      return std::fmod(lhs, rhs);
+    case OP_ID::EXP: {
+      auto res = std::pow(lhs, rhs);
+      return isint ? std::trunc(res) : res;
+    }
+    case OP_ID::GT:
+      return static_cast<double>(lhs > rhs);
+    case OP_ID::LT:
+      return static_cast<double>(lhs < rhs);
+    case OP_ID::GE:
+      return static_cast<double>(lhs >= rhs);
+    case OP_ID::LE:
+      return static_cast<double>(lhs <= rhs);
+    case OP_ID::AND:
+      return isint ? static_cast<double>(l & r) : toBool(lhs) * toBool(rhs);
+    case OP_ID::OR:
+      return isint ? static_cast<double>(l | r)
+                   : std::fmax(toBool(lhs), toBool(rhs));
+    case OP_ID::BITAND:
+      return toBool(lhs) * toBool(rhs);
+    case OP_ID::BITOR:
+      return std::fmax(toBool(lhs), toBool(rhs));
+    // shifts undefined on the host are left to runtime.
+    case OP_ID::LSHIFT:
+      if (r < 0 || r >= 64 || l < 0 ||
+          l > (std::numeric_limits<int64_t>::max() >> r)) {
+        return std::nullopt;
+      }
+      return static_cast<double>(l << r);
+    case OP_ID::RSHIFT:
+      if (r < 0 || r >= 64) {
+        return std::nullopt;
+      }
+      return static_cast<double>(l >> r);
+    default:
+      return std::nullopt;
+  }
+}
+
+std::optional<double> PartialEvaluator::evalCall(FcallInst& i,
+                                                 std::vector<double>& args) {
+  if (i.time || !(std::holds_alternative<types::Float>(i.type) ||
+                  std::holds_alternative<types::Int>(i.type))) {
+    return std::nullopt;
+  }
+  auto builtin = pure_builtins.find(i.fname);
+  if (builtin != pure_builtins.end()) {
+    return builtin->second(args);
+  }
+  auto fn = functions.find(i.fname);
+  if (fn == functions.end() || fn->second->args.size() != args.size()) {
+    return std::nullopt;
+  }
+  auto& fun = *fn->second;
+  Env env;
+  auto arg = args.begin();
+  for (auto& a : fun.args) {
+    env.emplace(a, *arg++);
+  }
+  std::optional<double> retval;
+  if (!evalBlock(*fun.body, env, retval)) {
+    return std::nullopt;
+  }
+  return retval;
+}
+
+bool PartialEvaluator::evalBlock(MIRblock& block, Env& env,
+                                 std::optional<double>& retval) {
+  for (auto& inst : block) {
+    if (++steps > max_steps) {
+      return false;  // possibly infinite recursion
+    }
+    bool res = std::visit(
+        overloaded{
+            [&](NumberInst& i) {
+              env.insert_or_assign(i.lv_name, i.val);
+              return true;
+            },
+            [&](AllocaInst& i) { return true; },
+            [&](AssignInst& i) {
+              auto v = lookup(i.val, env);
+              if (v) {
+                env.insert_or_assign(i.lv_name, v.value());
+              }
+              return v.has_value();
+            },
+            [&](OpInst& i) {
+              auto lhs = lookup(i.lhs, env);
+              auto rhs = lookup(i.rhs, env);
+              if (!lhs || !rhs) {
+                return false;
+              }
+              auto v = evalOp(i, lhs.value(), rhs.value());
+              if (v) {
+                env.insert_or_assign(i.lv_name, v.value());
+              }
+              return v.has_value();
+            },
+            [&](FcallInst& i) {
+              std::vector<double> args;
+              for (auto& a : i.args) {
+                auto v = lookup(a, env);
+                if (!v) {
+                  return false;
+                }
+                args.push_back(v.value());
+              }
+              auto v = evalCall(i, args);
+              if (v) {
+                env.insert_or_assign(i.lv_name, v.value());
+              }
+              return v.has_value();
+            },
+            [&](IfInst& i) {
+              auto cond = lookup(i.cond, env);
+              if (!cond) {
+                return false;
+              }
+              bool isthen = cond.value() > 0;
+              auto& branch = isthen ? *i.thenblock : *i.elseblock;
+              if (!evalBlock(branch, env, retval)) {
+                return false;
+              }
+              if (i.isexpr && !retval) {
+                auto v = lookup(isthen ? i.thenval : i.elseval, env);
+                if (v) {
+                  env.insert_or_assign(i.lv_name, v.value());
+                }
+                return v.has_value();
+              }
+              return true;
+            },
+            [&](ReturnInst& i) {
+              retval = lookup(i.val, env);
+              return retval.has_value();
+            },
+            // self, references, arrays, closures and loops are not evaluated
+            [](auto& i) { return false; }},
+        inst);
+    if (!res) {
+      return false;
+    }
+    if (retval) {
+      return true;
+    }
+  }
+  return true;
+}
+
+}  // namespace mimium
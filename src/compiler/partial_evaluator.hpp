@@ -0,0 +1,47 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+#include <functional>
+#include <set>
+
+#include "basic/mir.hpp"
+namespace mimium {
+
+// Evaluates arithmetics and calls of pure functions whose arguments are all
+// constant at compile time, and replaces them with NumberInst. A function is
+// pure if it can be interpreted only with its arguments and constants: use of
+// self, now, impure builtins or non-constant free variables stops evaluation
+// and the call is left as it is.
+class PartialEvaluator {
+ public:
+  PartialEvaluator() = default;
+  std::shared_ptr<MIRblock> process(std::shared_ptr<MIRblock> toplevel);
+  static bool isPureBuiltin(const std::string& fname) {
+    return pure_builtins.count(fname) > 0;
+  }
+
+ private:
+  using Env = std::unordered_map<std::string, double>;
+  // names defined only once by NumberInst, and the results of folding
+  Env constants;
+  std::set<std::string> assigned;
+  std::unordered_map<std::string, FunInst*> functions;
+  int steps = 0;
+  static const int max_steps = 100000;
+  static const std::unordered_map<
+      std::string, std::function<double(const std::vector<double>&)>>
+      pure_builtins;
+
+  void collect(MIRblock& block);
+  void foldBlock(MIRblock& block);
+  void replaceWithNumber(Instructions& inst, MIRinstruction& i, double val);
+  std::optional<double> lookup(const std::string& name, Env& env);
+  std::optional<double> evalOp(OpInst& i, double lhs, double rhs);
+  std::optional<double> evalCall(FcallInst& i, std::vector<double>& args);
+  // returns false if the block could not be evaluated.
+  bool evalBlock(MIRblock& block, Env& env, std::optional<double>& retval);
+};
+
+}  // namespace mimium
@@ -0,0 +1,341 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "compiler/rate_analyzer.hpp"
+
+#include "compiler/partial_evaluator.hpp"
+namespace mimium {
+
+std::shared_ptr<MIRblock> RateAnalyzer::process(
+    std::shared_ptr<MIRblock> toplevel) {
+  for (auto& inst : *toplevel) {
+    if (!std::holds_alternative<FunInst>(inst)) {
+      globals.emplace(std::visit([](auto& i) { return i.lv_name; }, inst));
+    }
+  }
+  collect(*toplevel);
+  collectPureFunctions(*toplevel);
+  bool hascache = false;
+  for (auto& inst : *toplevel) {
+    if (auto* fun = std::get_if<FunInst>(&inst)) {
+      hascache |= cacheFunction(*fun);
+    }
+  }
+  if (hascache) {
+    insertInvalidation(*toplevel);
+  }
+  return toplevel;
+}
+
+void RateAnalyzer::collect(MIRblock& block) {
+  for (auto& inst : block) {
+    std::visit(overloaded{[&](AssignInst& i) { assigned.emplace(i.lv_name); },
+                          [&](FunInst& i) {
+                            captured.insert(i.freevariables.begin(),
+                                            i.freevariables.end());
+                            collect(*i.body);
+                          },
+                          [&](IfInst& i) {
+                            collect(*i.thenblock);
+                            collect(*i.elseblock);
+                          },
+                          [&](ForInst& i) { collect(*i.body); },
+                          [](auto& i) {}},
+               inst);
+  }
+}
+// a function is pure when it has no free variables, does not refer self and
+// calls only pure functions.
+void RateAnalyzer::collectPureFunctions(MIRblock& toplevel) {
+  for (auto& inst : toplevel) {
+    if (auto* fun = std::get_if<FunInst>(&inst)) {
+      if (fun->freevariables.empty()) {
+        pure_functions.emplace(fun->lv_name);
+      }
+    }
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto& inst : toplevel) {
+      auto* fun = std::get_if<FunInst>(&inst);
+      if (fun != nullptr && pure_functions.count(fun->lv_name) > 0 &&
+          !isPureBlock(*fun->body)) {
+        pure_functions.erase(fun->lv_name);
+        changed = true;
+      }
+    }
+  }
+}
+
+bool RateAnalyzer::isPureBlock(MIRblock& block) {
+  for (auto& inst : block) {
+    std::vector<std::string> operands;
+    getOperands(inst, operands);
+    if (std::find(operands.begin(), operands.end(), "self") != operands.end()) {
+      return false;
+    }
+    bool res = std::visit(
+        overloaded{[](NumberInst& i) { return true; },
+                   [](AllocaInst& i) { return true; },
+                   [](AssignInst& i) { return true; },
+                   [](OpInst& i) { return true; },
+                   [](ReturnInst& i) { return true; },
+                   [&](FcallInst& i) {
+                     return !i.time &&
+                            (PartialEvaluator::isPureBuiltin(i.fname) ||
+                             pure_functions.count(i.fname) > 0);
+                   },
+                   [&](IfInst& i) {
+                     return isPureBlock(*i.thenblock) &&
+                            isPureBlock(*i.elseblock);
+                   },
+                   [&](ForInst& i) { return isPureBlock(*i.body); },
+                   [](auto& i) { return false; }},
+        inst);
+    if (!res) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// global variables of primitive type are the only free variables whose
+// changes are tracked by the caches.
+bool RateAnalyzer::isEventVariable(const std::string& name) {
+  if (globals.count(name) == 0) {
+    return false;
+  }
+  auto* type = typeenv.tryFind(name);
+  return type != nullptr && (std::holds_alternative<types::Float>(*type) ||
+                             std::holds_alternative<types::Int>(*type));
+}
+
+bool RateAnalyzer::cacheFunction(FunInst& fun) {
+  std::unordered_map<std::string, RATE> rates;
+  for (auto& fv : fun.freevariables) {
+    if (isEventVariable(fv)) {
+      rates.emplace(fv, RATE::EVENT);
+    }
+  }
+  auto rateof = [&](const std::string& name) {
+    auto it = rates.find(name);
+    return (it == rates.end()) ? RATE::AUDIO : it->second;
+  };
+  // only instructions at the top of function body are considered
+  auto& insts = fun.body->instructions;
+  std::unordered_map<std::string, inst_it> eventinsts;
+  std::unordered_map<std::string, std::vector<std::string>> operands;
+  for (auto it = insts.begin(); it != insts.end(); ++it) {
+    std::optional<RATE> rate;
+    std::vector<std::string> ops;
+    if (std::holds_alternative<NumberInst>(*it)) {
+      rate = RATE::CONSTANT;
+    } else if (auto* op = std::get_if<OpInst>(&*it)) {
+      rate = std::max(rateof(op->lhs), rateof(op->rhs));
+      ops = {op->lhs, op->rhs};
+    } else if (auto* fcall = std::get_if<FcallInst>(&*it)) {
+      bool ispure = !fcall->time &&
+                    (PartialEvaluator::isPureBuiltin(fcall->fname) ||
+                     pure_functions.count(fcall->fname) > 0);
+      if (ispure) {
+        rate = RATE::CONSTANT;
+        for (auto& a : fcall->args) {
+          rate = std::max(rate.value(), rateof(a));
+        }
+        ops.assign(fcall->args.begin(), fcall->args.end());
+      }
+    }
+    auto lv = std::visit([](auto& i) { return i.lv_name; }, *it);
+    if (!rate || assigned.count(lv) > 0) {
+      continue;
+    }
+    rates.emplace(lv, rate.value());
+    if (rate.value() == RATE::EVENT) {
+      eventinsts.emplace(lv, it);
+      operands.emplace(lv, std::move(ops));
+    }
+  }
+  if (eventinsts.empty()) {
+    return false;
+  }
+  // event-rate values used at audio rate are the roots of caches.
+  std::vector<inst_it> roots;
+  for (auto it = insts.begin(); it != insts.end(); ++it) {
+    auto lv = std::visit([](auto& i) { return i.lv_name; }, *it);
+    if (eventinsts.count(lv) > 0) {
+      continue;
+    }
+    std::vector<std::string> ops;
+    getOperands(*it, ops);
+    for (auto& o : ops) {
+      auto ev = eventinsts.find(o);
+      if (ev != eventinsts.end() &&
+          std::find(roots.begin(), roots.end(), ev->second) == roots.end()) {
+        roots.push_back(ev->second);
+      }
+    }
+  }
+  // dependencies in the order of original instructions
+  auto getdeps = [&](inst_it root) {
+    std::set<std::string> names;
+    std::vector<std::string> stack = {
+        std::visit([](auto& i) { return i.lv_name; }, *root)};
+    while (!stack.empty()) {
+      auto name = stack.back();
+      stack.pop_back();
+      if (eventinsts.count(name) > 0 && names.emplace(name).second) {
+        auto& ops = operands[name];
+        stack.insert(stack.end(), ops.begin(), ops.end());
+      }
+    }
+    std::vector<inst_it> deps;
+    for (auto it = insts.begin(); it != std::next(root); ++it) {
+      auto lv = std::visit([](auto& i) { return i.lv_name; }, *it);
+      if (names.count(lv) > 0) {
+        deps.push_back(it);
+      }
+    }
+    return deps;
+  };
+  // caching is worth only when the expression contains calls
+  auto iscacheable = [&](inst_it root, std::vector<inst_it>& deps) {
+    auto type = std::visit([](auto& i) { return i.type; }, *root);
+    bool isfloat = std::holds_alternative<types::Float>(type);
+    return isfloat && std::any_of(deps.begin(), deps.end(), [](inst_it d) {
+             return std::holds_alternative<FcallInst>(*d);
+           });
+  };
+  std::vector<std::vector<inst_it>> rootdeps;
+  std::set<std::string> keep;  // still computed at audio rate
+  for (auto& root : roots) {
+    auto& deps = rootdeps.emplace_back(getdeps(root));
+    if (!iscacheable(root, deps)) {
+      for (auto& d : deps) {
+        keep.emplace(std::visit([](auto& i) { return i.lv_name; }, *d));
+      }
+    }
+  }
+  bool hascache = false;
+  auto deps = rootdeps.begin();
+  for (auto& root : roots) {
+    auto lv = std::visit([](auto& i) { return i.lv_name; }, *root);
+    if (keep.count(lv) == 0 && iscacheable(root, *deps)) {
+      insertCache(fun, root, *deps);
+      hascache = true;
+    }
+    ++deps;
+  }
+  if (hascache) {
+    for (auto& [name, it] : eventinsts) {
+      if (keep.count(name) == 0) {
+        insts.erase(it);
+      }
+    }
+  }
+  return hascache;
+}
+// r = if(r$cache) {deps..., store r$new to the cache; r$new} else {cached}
+void RateAnalyzer::insertCache(FunInst& fun, inst_it root,
+                               std::vector<inst_it>& deps) {
+  auto lv = std::visit([](auto& i) { return i.lv_name; }, *root);
+  auto stalename = lv + "$cache";
+  auto newname = lv + "$new";
+  auto cachename = fun.lv_name + "." + stalename + ".value.mem";
+  Instructions check =
+      FcallInst(stalename, "cache_stale", {}, EXTERNAL, types::Int());
+  IfInst ifinst(lv, stalename, true);
+  for (auto& d : deps) {
+    Instructions copy = *d;
+    if (d == root) {
+      std::visit([&](auto& i) { i.lv_name = newname; }, copy);
+    }
+    ifinst.thenblock->addInst(copy);
+  }
+  Instructions store = AssignInst(cachename, newname, types::Float());
+  ifinst.thenblock->addInst(store);
+  ifinst.thenval = newname;
+  ifinst.elseval = cachename;
+  Instructions cached = ifinst;
+  std::visit([&](auto& i) { i.setParent(fun.body); }, check);
+  std::visit([&](auto& i) { i.setParent(fun.body); }, cached);
+  fun.body->instructions.insert(root, check);
+  fun.body->instructions.insert(root, cached);
+  typeenv.emplace(stalename, types::Int());
+  typeenv.emplace(newname, types::Float());
+}
+
+void RateAnalyzer::insertInvalidation(MIRblock& block) {
+  auto& insts = block.instructions;
+  for (auto it = insts.begin(); it != insts.end(); ++it) {
+    if (auto* assign = std::get_if<AssignInst>(&*it)) {
+      if (captured.count(assign->lv_name) > 0 &&
+          isEventVariable(assign->lv_name)) {
+        Instructions inv = FcallInst(
+            assign->lv_name + "$invalidate" + std::to_string(invalidatecount++),
+            "cache_invalidate", {}, EXTERNAL, types::Void());
+        std::visit([&](auto& i) { i.setParent(assign->parent); }, inv);
+        it = insts.insert(std::next(it), inv);
+      }
+    } else if (auto* fun = std::get_if<FunInst>(&*it)) {
+      insertInvalidation(*fun->body);
+    } else if (auto* ifinst = std::get_if<IfInst>(&*it)) {
+      insertInvalidation(*ifinst->thenblock);
+      insertInvalidation(*ifinst->elseblock);
+    } else if (auto* forinst = std::get_if<ForInst>(&*it)) {
+      insertInvalidation(*forinst->body);
+    }
+  }
+}
+
+void RateAnalyzer::getOperands(Instructions& inst,
+                               std::vector<std::string>& res) {
+  auto addblock = [&](MIRblock& block) {
+    for (auto& i : block) {
+      getOperands(i, res);
+    }
+  };
+  std::visit(
+      overloaded{
+          [&](RefInst& i) { res.push_back(i.val); },
+          [&](AssignInst& i) { res.push_back(i.val); },
+          [&](OpInst& i) {
+            res.push_back(i.lhs);
+            res.push_back(i.rhs);
+          },
+          [&](FcallInst& i) {
+            res.insert(res.end(), i.args.begin(), i.args.end());
+            if (i.time) {
+              res.push_back(i.time.value());
+            }
+          },
+          [&](MakeClosureInst& i) {
+            res.insert(res.end(), i.captures.begin(), i.captures.end());
+          },
+          [&](ArrayInst& i) {
+            res.insert(res.end(), i.args.begin(), i.args.end());
+          },
+          [&](ArrayAccessInst& i) {
+            res.push_back(i.name);
+            res.push_back(i.index);
+          },
+          [&](IfInst& i) {
+            res.push_back(i.cond);
+            addblock(*i.thenblock);
+            addblock(*i.elseblock);
+            if (i.isexpr) {
+              res.push_back(i.thenval);
+              res.push_back(i.elseval);
+            }
+          },
+          [&](ForInst& i) {
+            res.push_back(i.count);
+            addblock(*i.body);
+          },
+          [&](ReturnInst& i) { res.push_back(i.val); },
+          [](auto& i) {}},
+      inst);
+}
+
+}  // namespace mimium
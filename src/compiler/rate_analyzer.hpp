@@ -0,0 +1,43 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+#include <set>
+
+#include "basic/mir.hpp"
+namespace mimium {
+
+// Classifies values in each function into constant, event rate (depends only
+// on global variables, which may be written by tasks) and audio rate.
+// Event-rate expressions containing calls are moved into an if-expression
+// which recomputes them only when the cache is stale, otherwise the value
+// cached in the memory object is used. Every assignment to a captured global
+// variable of primitive type invalidates the caches by advancing a global
+// version counter.
+class RateAnalyzer {
+ public:
+  explicit RateAnalyzer(TypeEnv& typeenv) : typeenv(typeenv){};
+  std::shared_ptr<MIRblock> process(std::shared_ptr<MIRblock> toplevel);
+
+ private:
+  enum class RATE { CONSTANT, EVENT, AUDIO };
+  using inst_it = std::list<Instructions>::iterator;
+  TypeEnv& typeenv;
+  std::set<std::string> globals;
+  std::set<std::string> assigned;
+  std::set<std::string> captured;
+  std::set<std::string> pure_functions;
+  int invalidatecount = 0;
+
+  void collect(MIRblock& block);
+  void collectPureFunctions(MIRblock& toplevel);
+  bool isPureBlock(MIRblock& block);
+  bool isEventVariable(const std::string& name);
+  bool cacheFunction(FunInst& fun);
+  void insertCache(FunInst& fun, inst_it root, std::vector<inst_it>& deps);
+  void insertInvalidation(MIRblock& block);
+  static void getOperands(Instructions& inst, std::vector<std::string>& res);
+};
+
+}  // namespace mimium
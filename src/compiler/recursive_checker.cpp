@@ -89,14 +89,17 @@ void RecursiveChecker::visit(IfAST& ast) {
   ast.getCond()->accept(*this);
 
   ast.getThen()->accept(*this);
-  ast.getElse()->accept(*this);
+  if (ast.getElse() != nullptr) {
+    ast.getElse()->accept(*this);
+  }
 };
 
 void RecursiveChecker::visit(ReturnAST& ast) {
   ast.getExpr()->accept(*this);
 }
 void RecursiveChecker::visit(ForAST& ast) {
- //TODO(tomoya)
+  ast.getIterator()->accept(*this);
+  ast.getExpression()->accept(*this);
 }
 void RecursiveChecker::visit(DeclarationAST& ast) {
   // will not be called
@@ -0,0 +1,95 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "compiler/tailcall_optimizer.hpp"
+
+#include <queue>
+namespace mimium {
+
+std::shared_ptr<MIRblock> TailCallOptimizer::process(
+    std::shared_ptr<MIRblock> toplevel) {
+  for (auto& inst : *toplevel) {
+    if (auto* fun = std::get_if<FunInst>(&inst)) {
+      cur_fun = fun->lv_name;
+      callgraph[cur_fun];
+      auto& ftype = rv::get<types::Function>(fun->type);
+      bool isvoid = std::holds_alternative<types::Void>(ftype.ret_type);
+      markBlock(*fun->body, *fun, isvoid, "");
+    }
+  }
+  warnNonTailRecursion();
+  return toplevel;
+}
+
+void TailCallOptimizer::markBlock(MIRblock& block, FunInst& fun, bool istail,
+                                  const std::string& tailval) {
+  auto& insts = block.instructions;
+  for (auto it = insts.begin(); it != insts.end(); ++it) {
+    auto next = std::next(it);
+    bool islast = next == insts.end();
+    auto* nextret = islast ? nullptr : std::get_if<ReturnInst>(&*next);
+    if (auto* fcall = std::get_if<FcallInst>(&*it)) {
+      callgraph[cur_fun].emplace(fcall->fname);
+      if (!isSelfCall(*fcall)) {
+        continue;
+      }
+      bool isreturned = nextret != nullptr && nextret->val == fcall->lv_name;
+      bool isvoidtail = islast && istail && tailval.empty() &&
+                        std::holds_alternative<types::Void>(fcall->type);
+      bool isbranchtail =
+          islast && istail && !tailval.empty() && tailval == fcall->lv_name;
+      if (isreturned || isvoidtail || isbranchtail) {
+        fcall->istailcall = true;
+        fun.hastailcall = true;
+        if (isreturned) {
+          insts.erase(next);  // the call never returns here
+        }
+      } else {
+        nontail_functions.emplace(cur_fun);
+      }
+    } else if (auto* ifinst = std::get_if<IfInst>(&*it)) {
+      if (ifinst->isexpr) {
+        // if expression whose result is returned immediately
+        bool isreturned = nextret != nullptr && nextret->val == ifinst->lv_name;
+        bool isbranchtail = islast && istail && tailval == ifinst->lv_name;
+        bool tailctx = isreturned || isbranchtail;
+        markBlock(*ifinst->thenblock, fun, tailctx, ifinst->thenval);
+        markBlock(*ifinst->elseblock, fun, tailctx, ifinst->elseval);
+      } else {
+        bool tailctx = islast && istail && tailval.empty();
+        markBlock(*ifinst->thenblock, fun, tailctx, "");
+        markBlock(*ifinst->elseblock, fun, tailctx, "");
+      }
+    } else if (auto* forinst = std::get_if<ForInst>(&*it)) {
+      markBlock(*forinst->body, fun, false, "");
+    }
+  }
+}
+
+void TailCallOptimizer::warnNonTailRecursion() {
+  // traverse functions reachable from dsp
+  std::set<std::string> visited;
+  std::queue<std::string> queue;
+  queue.emplace("dsp");
+  while (!queue.empty()) {
+    auto fname = queue.front();
+    queue.pop();
+    auto it = callgraph.find(fname);
+    if (it == callgraph.end() || !visited.emplace(fname).second) {
+      continue;
+    }
+    if (nontail_functions.count(fname) > 0) {
+      Logger::debug_log("recursive function \"" + fname +
+                            "\" is called from dsp but it is not "
+                            "tail-recursive. Deep recursion may overflow the "
+                            "stack of the audio thread.",
+                        Logger::WARNING);
+    }
+    for (const auto& callee : it->second) {
+      queue.emplace(callee);
+    }
+  }
+}
+
+}  // namespace mimium
@@ -0,0 +1,35 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+#include <set>
+
+#include "basic/mir.hpp"
+namespace mimium {
+
+// Marks self-recursive calls in tail position so that code generator can
+// replace them with a jump to the beginning of the function, and warns
+// recursive functions called from dsp which cannot be converted into loop.
+class TailCallOptimizer {
+ public:
+  TailCallOptimizer() = default;
+  std::shared_ptr<MIRblock> process(std::shared_ptr<MIRblock> toplevel);
+  bool isTailRecursive(const std::string& fname) {
+    return nontail_functions.count(fname) == 0;
+  }
+
+ private:
+  std::string cur_fun;
+  std::unordered_map<std::string, std::set<std::string>> callgraph;
+  std::set<std::string> nontail_functions;
+
+  // tailval is the name of value returned right after the block ends, or
+  // empty when the function returns void.
+  void markBlock(MIRblock& block, FunInst& fun, bool istail,
+                 const std::string& tailval);
+  bool isSelfCall(FcallInst& i) { return i.fname == cur_fun && !i.time; }
+  void warnNonTailRecursion();
+};
+
+}  // namespace mimium
@@ -3,6 +3,8 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
  
 #include "compiler/type_infer_visitor.hpp"
+#include <cmath>
+#include <utility>
 
 namespace mimium {
 TypeInferVisitor::TypeInferVisitor()
@@ -17,6 +19,9 @@ void TypeInferVisitor::init() { has_return = false; }
 
 bool TypeInferVisitor::typeCheck(types::Value& lt, types::Value& rt) {
   bool res = lt.index() == rt.index();
+  if (res && std::holds_alternative<types::Vector>(lt)) {
+    res = lt == rt;  // vector length must be the same
+  }
   if (!res) {
     throw std::logic_error("type not matched");
   }
@@ -81,7 +86,7 @@ void TypeInferVisitor::visit(AssignAST& ast) {
   if (body->getid() == LAMBDA) {
     tmpfname = lname;
   }
-  body->accept(*this);
+  visitWithHint(body, ltype);
   auto r = stackPop();
   if (!unify(lvar->getVal(), r)) {
     throw std::logic_error("type " + lvar->getVal() +
@@ -129,12 +134,36 @@ void TypeInferVisitor::visit(SelfAST& ast) {
 }
 
 void TypeInferVisitor::visit(OpAST& ast) {
-  ast.lhs->accept(*this);
-  types::Value lhstype = stackPop();
-  ;
-  ast.rhs->accept(*this);
-  types::Value rhstype = stackPop();
-  ;
+  types::Value lhstype;
+  types::Value rhstype;
+  // a literal operand follows the type of the other side.
+  if (ast.lhs->getid() == NUMBER) {
+    ast.rhs->accept(*this);
+    rhstype = stackPop();
+    visitWithHint(ast.lhs, rhstype);
+    lhstype = stackPop();
+  } else {
+    ast.lhs->accept(*this);
+    lhstype = stackPop();
+    visitWithHint(ast.rhs, lhstype);
+    rhstype = stackPop();
+  }
+  bool islvec = std::holds_alternative<types::Vector>(lhstype);
+  bool isrvec = std::holds_alternative<types::Vector>(rhstype);
+  if (islvec || isrvec) {
+    auto id = ast.getOpId();
+    if (id == OP_ID::LSHIFT || id == OP_ID::RSHIFT) {
+      throw std::logic_error("shift operator is not defined for vector type");
+    }
+    // scalar operand is broadcasted to each lane.
+    auto& vectype = islvec ? lhstype : rhstype;
+    auto& other = islvec ? rhstype : lhstype;
+    if (!std::holds_alternative<types::Float>(other)) {
+      unify(vectype, other);
+    }
+    res_stack.push(vectype);
+    return;
+  }
   if (unify(lhstype, rhstype)) {
     std::logic_error("type of lhs and rhs is not matched");
   }
@@ -146,8 +175,17 @@ void TypeInferVisitor::visit(ListAST& ast) {
     line->accept(*this);
   }
 }
-void TypeInferVisitor::visit(NumberAST& /*ast*/) {
-  res_stack.push(*std::make_unique<types::Float>());
+void TypeInferVisitor::visit(NumberAST& ast) {
+  bool isintegral = std::trunc(ast.val) == ast.val;
+  if (isintegral && std::holds_alternative<types::Int>(literal_hint)) {
+    ast.type = types::Int();
+  }
+  res_stack.push(ast.type);
+}
+void TypeInferVisitor::visitWithHint(const AST_Ptr& ast, types::Value hint) {
+  auto prev = std::exchange(literal_hint, std::move(hint));
+  ast->accept(*this);
+  literal_hint = std::move(prev);
 }
 
 void TypeInferVisitor::visit(StringAST& /*ast*/) {
@@ -175,10 +213,15 @@ void TypeInferVisitor::visit(ArrayAST& ast) {
     tmpres = mr;
     ++c;
   }
-  // res_stack.push(types::Array(tmpres, elms.size()));
+  res_stack.push(types::Array(types::Float(), elms.size()));
 }
 void TypeInferVisitor::visit(ArrayAccessAST& ast) {
   auto type = typeenv.find(ast.getName()->getVal());
+  if (std::holds_alternative<types::Vector>(type)) {
+    // lane access
+    res_stack.push(types::Float());
+    return;
+  }
   types::Value res;
   //fixme
   types::Value arr = types::Array(types::Float());
@@ -198,6 +241,45 @@ void TypeInferVisitor::visit(ArrayAccessAST& ast) {
 // }
 
 void TypeInferVisitor::visit(FcallAST& ast) {
+  if (isArrayConstructor(ast)) {
+    res_stack.push(types::Array(types::Float(), getArrayConstructorSize(ast)));
+    return;
+  }
+  if (isDelay(ast)) {
+    auto& args = ast.getArgs()->getElements();
+    getDelayMaxSize(ast);
+    visitWithHint(args[1], types::Float());
+    auto inputtype = stackPop();
+    types::Value f = types::Float();
+    unify(inputtype, f);
+    // integer delay time does not interpolate
+    visitWithHint(args[2], types::None());
+    auto timetype = stackPop();
+    if (!std::holds_alternative<types::Int>(timetype)) {
+      unify(timetype, f);
+    }
+    res_stack.push(types::Float());
+    return;
+  }
+  if (isHistory(ast)) {
+    getHistoryLength(ast);
+    // past value has the same type as the current one
+    ast.getArgs()->getElements().front()->accept(*this);
+    return;
+  }
+  if (isArrayLookup(ast)) {
+    auto& args = ast.getArgs()->getElements();
+    if (args.size() < 2 || args.size() > 4 || args.front()->getid() != RVAR) {
+      throw std::logic_error(
+          "usage: lookup(array, index, \"none|linear|cubic\", "
+          "\"clamp|wrap\")");
+    }
+    auto arrname = std::static_pointer_cast<RvarAST>(args.front())->getVal();
+    types::Value arr = types::Array(types::Float());
+    unify(typeenv.find(arrname), arr);
+    res_stack.push(types::Float());
+    return;
+  }
   ast.getFname()->accept(*this);
   auto ftype = stackPop();
   auto& fn = rv::get<types::Function>(ftype);
@@ -206,27 +288,111 @@ void TypeInferVisitor::visit(FcallAST& ast) {
   auto args = ast.getArgs()->getElements();
   std::vector<types::Value> argtypes;
   bool checkflag = true;
+  bool islanewise =
+      ast.getFname()->getid() == RVAR &&
+      LLVMBuiltin::lanewise.count(
+          std::static_pointer_cast<RvarAST>(ast.getFname())->getVal()) > 0;
+  std::optional<types::Value> vectype = std::nullopt;
   for (int i = 0; i < args.size(); i++) {
-    args[i]->accept(*this);
+    visitWithHint(args[i], fnargtypes[i]);
     auto r = stackPop();
+    if (islanewise && std::holds_alternative<types::Vector>(r)) {
+      if (vectype) {
+        checkflag &= unify(vectype.value(), r);
+      }
+      vectype = r;
+      continue;
+    }
     checkflag &= unify(fnargtypes[i], r);
   }
   if (!checkflag) {
     throw std::invalid_argument("argument types were invalid");
   }
   if(ast.time!=nullptr){
-    ast.time->accept(*this);
+    visitWithHint(ast.time, types::Float());
     auto timetype = stackPop();
     types::Value f= types::Float();
     unify(timetype,f);
   }
-  res_stack.push(fn.getReturnType());
+  res_stack.push(vectype.value_or(fn.getReturnType()));
+}
+// Array(size) makes a zero-initialized array. The size must be known at
+// compile time.
+bool TypeInferVisitor::isArrayConstructor(FcallAST& ast) {
+  return ast.getFname()->getid() == RVAR &&
+         std::static_pointer_cast<RvarAST>(ast.getFname())->getVal() ==
+             "Array";
+}
+// lookup(array, index, interp, boundary) is array access with explicit
+// interpolation and boundary mode.
+bool TypeInferVisitor::isArrayLookup(FcallAST& ast) {
+  return ast.getFname()->getid() == RVAR &&
+         std::static_pointer_cast<RvarAST>(ast.getFname())->getVal() ==
+             "lookup";
+}
+bool TypeInferVisitor::isDelay(FcallAST& ast) {
+  return ast.getFname()->getid() == RVAR &&
+         std::static_pointer_cast<RvarAST>(ast.getFname())->getVal() ==
+             "delay";
+}
+int TypeInferVisitor::getDelayMaxSize(FcallAST& ast) {
+  auto& args = ast.getArgs()->getElements();
+  if (args.size() != 3 || args.front()->getid() != NUMBER) {
+    throw std::logic_error(
+        "usage: delay(maxsize, input, time), maxsize must be a number literal");
+  }
+  auto size = std::static_pointer_cast<NumberAST>(args.front())->getVal();
+  if (size < 1) {
+    throw std::logic_error("maxsize of delay must be positive");
+  }
+  return static_cast<int>(std::ceil(size));
+}
+// history(var,n) is what self[-n] and arg[-n] are desugared to. The length of
+// its buffer is decided at compile time, so n must be a number literal.
+bool TypeInferVisitor::isHistory(FcallAST& ast) {
+  return ast.getFname()->getid() == RVAR &&
+         std::static_pointer_cast<RvarAST>(ast.getFname())->getVal() ==
+             "history";
+}
+int TypeInferVisitor::getHistoryLength(FcallAST& ast) {
+  auto& args = ast.getArgs()->getElements();
+  if (args.size() != 2 || args.back()->getid() != NUMBER) {
+    throw std::logic_error(
+        "the length of history must be a number literal, like self[-1]");
+  }
+  auto id = args.front()->getid();
+  if (id != SELF && id != RVAR) {
+    throw std::logic_error("history is available only for self and arguments");
+  }
+  auto length = std::static_pointer_cast<NumberAST>(args.back())->getVal();
+  if (length < 0 || length != std::floor(length)) {
+    throw std::logic_error("the length of history must be a natural number");
+  }
+  if (id == SELF && length < 1) {
+    throw std::logic_error("self[-0] cannot be referred, use self[-1]");
+  }
+  return static_cast<int>(length);
+}
+int TypeInferVisitor::getArrayConstructorSize(FcallAST& ast) {
+  auto& args = ast.getArgs()->getElements();
+  if (args.size() != 1 || args.front()->getid() != NUMBER) {
+    throw std::logic_error("size of Array() must be a number literal");
+  }
+  auto size = std::static_pointer_cast<NumberAST>(args.front())->getVal();
+  if (size < 1 || std::trunc(size) != size) {
+    throw std::logic_error("size of Array() must be a positive integer");
+  }
+  return static_cast<int>(size);
 }
 void TypeInferVisitor::visit(LambdaAST& ast) {
   // type registoration for each arguments
   auto args = ast.getArgs();
   std::vector<types::Value> argtypes;
   for (const auto& a : args->getElements()) {
+    if (a->isconst) {  // should have been specialized in alpha conversion
+      throw std::logic_error("constant parameter " + a->getVal() +
+                             " is allowed only for global function");
+    }
     a->accept(*this);
     auto r = stackPop();
     typeenv.emplace(a->getVal(), r);
@@ -248,7 +414,7 @@ void TypeInferVisitor::visit(LambdaAST& ast) {
   types::Value res_type =
       types::Function(current_return_type.value(), argtypes);
   typeenv.emplace(tmpfname, res_type);
-  ast.getBody()->accept(*this);
+  visitWithHint(ast.getBody(), types::None());
   auto& ref = rv::get<types::Function>(typeenv.find(tmpfname));
   types::Value ret_type = (has_return) ? stackPop() : types::Void();
   unify(ret_type, ref.ret_type);
@@ -259,10 +425,13 @@ void TypeInferVisitor::visit(LambdaAST& ast) {
   current_return_type = std::nullopt;
 }
 void TypeInferVisitor::visit(IfAST& ast) {
-  ast.getCond()->accept(*this);
+  visitWithHint(ast.getCond(), types::None());
   auto condval =stackPop();
-  types::Value ref =types::Float();
-  unify(condval,ref);
+  // integer condition is also allowed
+  if (!std::holds_alternative<types::Int>(condval)) {
+    types::Value ref = types::Float();
+    unify(condval, ref);
+  }
   if(ast.isexpr){
   // auto newcond = stack_pop_ptr();
   ast.getThen()->accept(*this);
@@ -271,6 +440,11 @@ void TypeInferVisitor::visit(IfAST& ast) {
   auto elseval =stackPop();
   unify(thenval,elseval);
   res_stack.push(thenval);
+  } else {
+    ast.getThen()->accept(*this);
+    if (ast.getElse() != nullptr) {
+      ast.getElse()->accept(*this);
+    }
   }
   // auto newelse = stack_pop_ptr();
   // auto newast =
@@ -279,22 +453,24 @@ void TypeInferVisitor::visit(IfAST& ast) {
 };
 
 void TypeInferVisitor::visit(ReturnAST& ast) {
-  ast.getExpr()->accept(*this);
+  visitWithHint(ast.getExpr(),
+                current_return_type.value_or(types::Value(types::None())));
   has_return = true;
 }
 void TypeInferVisitor::visit(ForAST& ast) {
-  // env = env->createNewChild("forloop"+std::to_string(envcount));
-  // envcount++;
-  // ast.getVar()->accept(*this);
-  // auto newvar = stack_pop_ptr();
-  // ast.getIterator()->accept(*this);
-  // auto newiter = stack_pop_ptr();
-  // ast.getExpression()->accept(*this);
-  // auto newexpr = stack_pop_ptr();
-  // auto newast =
-  // std::make_unique<IfAST>(std::move(newvar),std::move(newiter),std::move(newexpr));
-  // res_stack.push(std::move(newast));
-  // env = env->getParent();
+  // for now, iterator is a number of loops and loop variable has the same type
+  // as it(float or int).
+  visitWithHint(ast.getIterator(), types::None());
+  auto itertype = stackPop();
+  auto var = std::static_pointer_cast<LvarAST>(ast.getVar());
+  if (std::holds_alternative<types::Int>(itertype)) {
+    typeenv.emplace(var->getVal(), types::Int());
+  } else {
+    types::Value ref = types::Float();
+    unify(itertype, ref);
+    typeenv.emplace(var->getVal(), types::Float());
+  }
+  ast.getExpression()->accept(*this);
 }
 void TypeInferVisitor::visit(DeclarationAST& ast) {
   // will not be called
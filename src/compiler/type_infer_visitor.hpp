@@ -31,6 +31,8 @@ struct TypevarReplaceVisitor {
   }
   // default behaviour for primitive
   types::Value operator()(types::Float& i) { return i; }
+  types::Value operator()(types::Int& i) { return i; }
+  types::Value operator()(types::Vector& i) { return i; }
   types::Value operator()(types::String& i) { return i; }
   types::Value operator()(types::None& i) { return i; }
   types::Value operator()(types::Void& i) { return i; }
@@ -119,6 +121,14 @@ class TypeInferVisitor : public ASTVisitor {
   void visit(StructAST& ast) override;
   void visit(StructAccessAST& ast) override;
 
+  static bool isArrayConstructor(FcallAST& ast);
+  static int getArrayConstructorSize(FcallAST& ast);
+  static bool isArrayLookup(FcallAST& ast);
+  static bool isDelay(FcallAST& ast);
+  static int getDelayMaxSize(FcallAST& ast);
+  static bool isHistory(FcallAST& ast);
+  static int getHistoryLength(FcallAST& ast);
+
   bool typeCheck(types::Value& lt, types::Value& rt);
   bool unify(types::Value& lt, types::Value& rt);
 
@@ -140,6 +150,10 @@ class TypeInferVisitor : public ASTVisitor {
 
  private:
   std::stack<types::Value> res_stack;
+  // expected type of the expression currently visited, used to give a type
+  // to number literals.
+  types::Value literal_hint = types::None();
+  void visitWithHint(const AST_Ptr& ast, types::Value hint);
   // static bool checkArg(types::Value& fnarg, types::Value& givenarg);
   void unifyTypeVar(types::TypeVar& tv, types::Value& v);
   // hold value for infer type of "self"
@@ -56,6 +56,33 @@ auto main(int argc, char** argv) -> int {
                      "emit LLVM IR to stdout")),
       cl::cat(general_category));
   compile_stage.setInitialValue(CompileStage::EXECUTE);
+  cl::opt<bool> reciprocal_math(
+      "reciprocal-math",
+      cl::desc("Allow division by constant to be multiplication by its "
+               "reciprocal, and pow(x,0.5) to be sqrt(x)"),
+      cl::init(false), cl::cat(general_category));
+  cl::opt<bool> fast_math(
+      "fast-math",
+      cl::desc("Enable fast-math floating point flags and reciprocal math for "
+               "functions not annotated as \"strict\""),
+      cl::init(false), cl::cat(general_category));
+  cl::opt<bool> approx_math(
+      "approx-math",
+      cl::desc("Replace sin, cos, exp, exp2 and tanh with polynomial "
+               "approximations (fastsin etc.) in functions not annotated as "
+               "\"strict\""),
+      cl::init(false), cl::cat(general_category));
+  enum class Precision { F64, F32 };
+  cl::opt<Precision> precision(
+      "precision", cl::desc("Floating point precision of signals"),
+      cl::values(clEnumValN(Precision::F64, "f64", "double (default)"),
+                 clEnumValN(Precision::F32, "f32",
+                            "float, the runtime still passes time and "
+                            "arguments of tasks as double")),
+      cl::init(Precision::F64), cl::cat(general_category));
+  cl::opt<unsigned> seed(
+      "seed", cl::desc("Seed for the noise builtins (random, pinknoise etc.)"),
+      cl::init(0), cl::cat(general_category));
 
   cl::ResetAllOptionOccurrences();
   cl::SetVersionPrinter([](llvm::raw_ostream& out) {
@@ -99,6 +126,11 @@ auto main(int argc, char** argv) -> int {
       Logger::debug_log("Opening " + filename, Logger::INFO);
       compiler->setFilePath(filename);
       compiler->setDataLayout(runtime->getJitEngine().getDataLayout());
+      compiler->setReciprocalMath(reciprocal_math || fast_math);
+      compiler->setFastMath(fast_math);
+      compiler->setApproxMath(approx_math);
+      compiler->setRandomSeed(seed);
+      compiler->setSinglePrecision(precision == Precision::F32);
 
       auto stage = compile_stage.getValue();
       do {
@@ -118,11 +150,15 @@ auto main(int argc, char** argv) -> int {
           break;
         }
         auto mir = compiler->generateMir(ast_u);
+        mir = compiler->partialEvaluate(mir);
+        mir = compiler->simplifyMath(mir);
         if (stage == CompileStage::MIR) {
           std::cout << mir->toString() << std::endl;
           break;
         }
         auto mir_cc = compiler->closureConvert(mir);
+        mir_cc = compiler->optimizeTailCalls(mir_cc);
+        mir_cc = compiler->analyzeRate(mir_cc);
         mir_cc = compiler->collectMemoryObjs(mir_cc);
         if (stage == CompileStage::MIR_CC) {
           std::cout << mir_cc->toString() << std::endl;
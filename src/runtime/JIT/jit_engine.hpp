@@ -3,11 +3,15 @@
  * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
 
 #pragma once
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <thread>
 
 #include "llvm-c/ExecutionEngine.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
@@ -22,12 +26,19 @@
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "llvm/Transforms/Utils.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 #include "llvm/Transforms/Vectorize.h"
 
 #define LAZY_ENABLE 0
@@ -37,6 +48,11 @@
 #define LLJITCLASS LLJIT
 #endif
 
+// modules which define less functions than this are compiled as a single unit.
+#define MIMIUM_PARTITION_THRESHOLD 64
+// optimization level of the pipeline applied before compilation.
+#define MIMIUM_OPT_LEVEL 3
+
 namespace llvm {
 namespace orc {
 
@@ -53,6 +69,7 @@ class MimiumJIT {
 
   MangleAndInterner Mangle;
   ThreadSafeContext Ctx;
+  unsigned num_threads;
 
  public:
   MimiumJIT()
@@ -61,9 +78,22 @@ class MimiumJIT {
         DL(lllazyjit->getDataLayout()),
         MainJD(lllazyjit->getMainJITDylib()),
         Mangle(ES, this->DL),
-        Ctx(std::make_unique<LLVMContext>()) {
+        Ctx(std::make_unique<LLVMContext>()),
+        num_threads(getNumThreads()) {
     #if LAZY_ENABLE
     lllazyjit->setLazyCompileTransform(optimizeModule);
+    #elif LLVM_VERSION_MAJOR >= 10
+    // runs on the compile threads together with the code generation.
+    // partitions are optimized as a whole before splitting and skipped here.
+    lllazyjit->getIRTransformLayer().setTransform(
+        [](ThreadSafeModule TSM, auto& /*R*/) -> Expected<ThreadSafeModule> {
+          TSM.withModuleDo([](Module& M) {
+            if (M.getModuleFlag("mimium.optimized") == nullptr) {
+              runOptimizationPasses(M);
+            }
+          });
+          return TSM;
+        });
     #endif
 // MainJD.getExecutionSession()
 #if LLVM_VERSION_MAJOR >= 10
@@ -76,12 +106,20 @@ class MimiumJIT {
             DL.getGlobalPrefix())));
 #endif
   }
+  static unsigned getNumThreads() {
+    return std::max(1U, std::thread::hardware_concurrency());
+  }
   static std::unique_ptr<LLJITCLASS> createEngine() {
     #if LAZY_ENABLE
     auto builder = LLLazyJITBuilder();
     #else
     auto builder = LLJITBuilder();
     #endif
+    // materialization of each module is dispatched to a thread pool, so that
+    // partitions of a large program are compiled concurrently.
+    if (getNumThreads() > 1) {
+      builder.setNumCompileThreads(getNumThreads());
+    }
     auto jit = builder.create();
     llvm::logAllUnhandledErrors(jit.takeError(), llvm::errs());
     return std::move(jit.get());
@@ -90,9 +128,74 @@ class MimiumJIT {
     #if LAZY_ENABLE
     return lllazyjit->addLazyIRModule(ThreadSafeModule(std::move(M), Ctx));
     #else
+    auto numdefined = std::count_if(M->begin(), M->end(), [](Function& f) {
+      return !f.isDeclaration();
+    });
+    if (num_threads > 1 && numdefined >= MIMIUM_PARTITION_THRESHOLD) {
+      // inlining into dsp must see the whole program
+      runOptimizationPasses(*M);
+      M->addModuleFlag(Module::Warning, "mimium.optimized", 1);
+      return addModulePartitioned(std::move(M), num_threads);
+    }
+#if LLVM_VERSION_MAJOR < 10
+    runOptimizationPasses(*M);
+#endif
     return  lllazyjit->addIRModule(ThreadSafeModule(std::move(M), Ctx));
     #endif
   }
+  // Split a large optimized module into N partitions and add each of them with
+  // its own LLVMContext, so that the compile threads do not contend on a single
+  // context lock. Local symbols are externalized by SplitModule, thus calls
+  // across partitions are resolved by the JITDylib as usual.
+  Error addModulePartitioned(std::unique_ptr<Module> M, unsigned N) {
+    std::vector<std::unique_ptr<Module>> parts;
+    auto callback = [&](std::unique_ptr<Module> part) {
+      parts.emplace_back(std::move(part));
+    };
+#if LLVM_VERSION_MAJOR >= 13
+    SplitModule(*M, N, callback, false);
+#else
+    SplitModule(std::move(M), N, callback, false);
+#endif
+    // writing bitcode touches the shared context and stays on this thread,
+    // reading into the new contexts runs in parallel.
+    std::vector<SmallVector<char, 1024>> buffers(parts.size());
+    for (size_t i = 0; i < parts.size(); i++) {
+      raw_svector_ostream os(buffers[i]);
+      WriteBitcodeToFile(*parts[i], os);
+    }
+    std::vector<std::unique_ptr<LLVMContext>> ctxs(parts.size());
+    std::vector<std::unique_ptr<Module>> newmodules(parts.size());
+    std::vector<std::string> errors(parts.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < parts.size(); i++) {
+      workers.emplace_back([&, i]() {
+        ctxs[i] = std::make_unique<LLVMContext>();
+        MemoryBufferRef ref(StringRef(buffers[i].data(), buffers[i].size()),
+                            parts[i]->getModuleIdentifier());
+        auto newmodule = parseBitcodeFile(ref, *ctxs[i]);
+        if (newmodule) {
+          newmodules[i] = std::move(newmodule.get());
+        } else {
+          errors[i] = toString(newmodule.takeError());
+        }
+      });
+    }
+    for (auto& w : workers) {
+      w.join();
+    }
+    for (size_t i = 0; i < parts.size(); i++) {
+      if (!errors[i].empty()) {
+        return make_error<StringError>(errors[i], inconvertibleErrorCode());
+      }
+      auto err = lllazyjit->addIRModule(
+          ThreadSafeModule(std::move(newmodules[i]), std::move(ctxs[i])));
+      if (err) {
+        return err;
+      }
+    }
+    return Error::success();
+  }
   Expected<JITEvaluatedSymbol> lookup(StringRef name) {
     return lllazyjit->lookup(name);
   }
@@ -112,6 +215,66 @@ class MimiumJIT {
     return res.takeError();
   }
 
+  // Registers vector variants of math functions (llvm.sin.f64 ->
+  // _ZGVdN4v_sin etc.) so that the vectorizer can widen the calls. The library
+  // is loaded into the process to let the JIT resolve its symbols; glibc's
+  // libmvec is preferred, then Intel SVML. Without them the calls stay scalar.
+  static TargetLibraryInfoImpl* createLibraryInfo(Module& M) {
+    Triple triple(M.getTargetTriple());
+    auto* tlii = new TargetLibraryInfoImpl(triple);
+    static auto veclib = [&]() {
+      bool isx86 = triple.getArch() == Triple::x86_64;
+#if LLVM_VERSION_MAJOR >= 13
+      if (isx86 && triple.isOSLinux() &&
+          !sys::DynamicLibrary::LoadLibraryPermanently("libmvec.so.1")) {
+        return TargetLibraryInfoImpl::LIBMVEC_X86;
+      }
+#endif
+      if (isx86 && !sys::DynamicLibrary::LoadLibraryPermanently("libsvml.so")) {
+        return TargetLibraryInfoImpl::SVML;
+      }
+      return TargetLibraryInfoImpl::NoLibrary;
+    }();
+    tlii->addVectorizableFunctionsFromVecLib(veclib);
+    return tlii;
+  }
+
+  // Standard O3 pipeline with loop/SLP vectorizer, tuned for the host CPU.
+  static void runOptimizationPasses(Module& M) {
+    auto tmbuilder = JITTargetMachineBuilder::detectHost();
+    if (!tmbuilder) {
+      logAllUnhandledErrors(tmbuilder.takeError(), errs());
+      return;
+    }
+    tmbuilder->setCodeGenOptLevel(CodeGenOpt::Aggressive);
+    auto tm = tmbuilder->createTargetMachine();
+    if (!tm) {
+      logAllUnhandledErrors(tm.takeError(), errs());
+      return;
+    }
+    PassManagerBuilder pmbuilder;
+    pmbuilder.OptLevel = MIMIUM_OPT_LEVEL;
+    pmbuilder.SizeLevel = 0;
+    pmbuilder.Inliner = createFunctionInliningPass(MIMIUM_OPT_LEVEL, 0, false);
+    pmbuilder.LoopVectorize = true;
+    pmbuilder.SLPVectorize = true;
+    pmbuilder.LibraryInfo = createLibraryInfo(M);  // owned by pmbuilder
+    (*tm)->adjustPassManager(pmbuilder);
+
+    legacy::FunctionPassManager fpm(&M);
+    legacy::PassManager mpm;
+    fpm.add(createTargetTransformInfoWrapperPass((*tm)->getTargetIRAnalysis()));
+    mpm.add(createTargetTransformInfoWrapperPass((*tm)->getTargetIRAnalysis()));
+    pmbuilder.populateFunctionPassManager(fpm);
+    pmbuilder.populateModulePassManager(mpm);
+    fpm.doInitialization();
+    for (auto& f : M) {
+      fpm.run(f);
+    }
+    fpm.doFinalization();
+    mpm.run(M);
+  }
+
   static Expected<ThreadSafeModule> optimizeModule(
       ThreadSafeModule M, const MaterializationResponsibility& R) {
 // Create a function pass manager.
@@ -0,0 +1,110 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "runtime/scheduler/closure_pool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace mimium {
+
+ClosurePool::ClosurePool() {
+  chunks.reserve(64);
+  pending.reserve(256);
+}
+ClosurePool::~ClosurePool() {
+  for (auto& [begin, end] : chunks) {
+    std::free(begin);
+  }
+}
+
+ClosurePool::Header* ClosurePool::getHeader(void* ptr) {
+  return reinterpret_cast<Header*>(static_cast<char*>(ptr) - header_size);
+}
+
+size_t ClosurePool::getSizeClass(size_t size) {
+  size_t sizeclass = 0;
+  while (sizeclass < num_classes &&
+         (size_t(1) << (sizeclass + min_block_log2)) < size) {
+    ++sizeclass;
+  }
+  return sizeclass;
+}
+
+void ClosurePool::refill(size_t sizeclass) {
+  auto blocksize = header_size + (size_t(1) << (sizeclass + min_block_log2));
+  auto* chunk = static_cast<char*>(std::malloc(blocksize * blocks_per_chunk));
+  if (chunk == nullptr) {
+    throw std::bad_alloc();
+  }
+  chunks.emplace_back(chunk, chunk + blocksize * blocks_per_chunk);
+  auto& list = freelists[sizeclass];
+  for (size_t i = 0; i < blocks_per_chunk; ++i) {
+    list.push_back(chunk + blocksize * i + header_size);
+  }
+}
+
+void* ClosurePool::allocate(size_t size) {
+  auto sizeclass = getSizeClass(size);
+  void* res = nullptr;
+  if (sizeclass == oversize) {
+    // rare case, a block is made for the capture itself
+    auto* chunk = static_cast<char*>(std::malloc(header_size + size));
+    if (chunk == nullptr) {
+      throw std::bad_alloc();
+    }
+    chunks.emplace_back(chunk, chunk + header_size + size);
+    res = chunk + header_size;
+  } else {
+    auto& list = freelists[sizeclass];
+    if (list.empty()) {
+      refill(sizeclass);
+    }
+    res = list.back();
+    list.pop_back();
+  }
+  auto* header = getHeader(res);
+  header->sizeclass = static_cast<uint32_t>(sizeclass);
+  header->refcount = 1;  // owned by the creator until the next collection
+  pending.push_back(res);
+  return res;
+}
+
+bool ClosurePool::owns(void* ptr) const {
+  auto* p = static_cast<char*>(ptr);
+  return std::any_of(chunks.begin(), chunks.end(), [p](const auto& chunk) {
+    return chunk.first < p && p < chunk.second;
+  });
+}
+
+void ClosurePool::retain(void* ptr) { getHeader(ptr)->refcount++; }
+
+void ClosurePool::release(void* ptr) {
+  if (--getHeader(ptr)->refcount == 0) {
+    freeBlock(ptr);
+  }
+}
+
+void ClosurePool::collect() {
+  for (auto* ptr : pending) {
+    release(ptr);
+  }
+  pending.clear();
+}
+
+void ClosurePool::freeBlock(void* ptr) {
+  auto sizeclass = getHeader(ptr)->sizeclass;
+  if (sizeclass != oversize) {
+    freelists[sizeclass].push_back(ptr);
+    return;
+  }
+  auto* chunk = static_cast<char*>(ptr) - header_size;
+  chunks.erase(std::find_if(chunks.begin(), chunks.end(), [chunk](auto& c) {
+    return c.first == chunk;
+  }));
+  std::free(chunk);
+}
+
+}  // namespace mimium
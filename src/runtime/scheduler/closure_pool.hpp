@@ -0,0 +1,56 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mimium {
+// Fixed size blocks for captures of closures passed to scheduled tasks, made
+// outside of tasks(inside tasks they are placed in the region of the task).
+// Blocks are reference counted: the creator holds a reference until collect()
+// is called after it has finished, adding a task retains the block and
+// finishing the task releases it.
+// Memory is taken from the system only when a size class runs out, so that
+// the steady state of audio thread does not call malloc.
+class ClosurePool {
+ public:
+  ClosurePool();
+  ~ClosurePool();
+  ClosurePool(const ClosurePool&) = delete;
+  ClosurePool& operator=(const ClosurePool&) = delete;
+
+  void* allocate(size_t size);
+  bool owns(void* ptr) const;
+  void retain(void* ptr);
+  void release(void* ptr);
+  // drop references of creators for blocks allocated since the last call
+  void collect();
+
+ private:
+  struct Header {
+    uint32_t sizeclass;
+    uint32_t refcount;
+  };
+  // keeps payload aligned as malloc does
+  static constexpr size_t header_size = 16;
+  static constexpr size_t min_block_log2 = 4;  // 16 bytes
+  static constexpr size_t num_classes = 9;     // up to 4096 bytes
+  static constexpr size_t oversize = num_classes;
+  static constexpr size_t blocks_per_chunk = 64;
+
+  std::array<std::vector<void*>, num_classes> freelists;
+  std::vector<std::pair<char*, char*>> chunks;
+  std::vector<void*> pending;
+
+  static Header* getHeader(void* ptr);
+  static size_t getSizeClass(size_t size);
+  void refill(size_t sizeclass);
+  void freeBlock(void* ptr);
+};
+
+}  // namespace mimium
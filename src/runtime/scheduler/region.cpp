@@ -0,0 +1,99 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#include "runtime/scheduler/region.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace mimium {
+
+RegionAllocator::RegionAllocator() {
+  chunks.reserve(64);
+  freechunks.reserve(64);
+  freeregions.reserve(64);
+}
+RegionAllocator::~RegionAllocator() {
+  for (auto& chunk : chunks) {
+    std::free(chunk.begin);
+  }
+  for (auto* chunk : freechunks) {
+    std::free(chunk);
+  }
+  for (auto* region : freeregions) {
+    delete region;
+  }
+}
+
+RegionAllocator::Region* RegionAllocator::create(Region* parent) {
+  Region* region = nullptr;
+  if (freeregions.empty()) {
+    region = new Region();
+  } else {
+    region = freeregions.back();
+    freeregions.pop_back();
+  }
+  region->refcount = 1;
+  region->parent = parent;
+  region->pos = nullptr;
+  region->end = nullptr;
+  if (parent != nullptr) {
+    retain(parent);
+  }
+  return region;
+}
+
+void RegionAllocator::release(Region* region) {
+  while (region != nullptr && --region->refcount == 0) {
+    auto it = std::remove_if(chunks.begin(), chunks.end(), [&](Chunk& c) {
+      if (c.owner != region) {
+        return false;
+      }
+      if (static_cast<size_t>(c.end - c.begin) == chunk_size) {
+        freechunks.push_back(c.begin);
+      } else {
+        std::free(c.begin);
+      }
+      return true;
+    });
+    chunks.erase(it, chunks.end());
+    freeregions.push_back(region);
+    region = region->parent;
+  }
+}
+
+void* RegionAllocator::allocate(Region* region, size_t size) {
+  size = (size + alignment - 1) / alignment * alignment;
+  if (region->pos == nullptr ||
+      static_cast<size_t>(region->end - region->pos) < size) {
+    char* begin = nullptr;
+    auto newsize = std::max(size, chunk_size);
+    if (newsize == chunk_size && !freechunks.empty()) {
+      begin = freechunks.back();
+      freechunks.pop_back();
+    } else {
+      begin = static_cast<char*>(std::malloc(newsize));
+      if (begin == nullptr) {
+        throw std::bad_alloc();
+      }
+    }
+    chunks.push_back(Chunk{begin, begin + newsize, region});
+    region->pos = begin;
+    region->end = begin + newsize;
+  }
+  auto* res = region->pos;
+  region->pos += size;
+  return res;
+}
+
+RegionAllocator::Region* RegionAllocator::find(void* ptr) const {
+  auto* p = static_cast<char*>(ptr);
+  auto it = std::find_if(chunks.begin(), chunks.end(), [p](const Chunk& c) {
+    return c.begin <= p && p < c.end;
+  });
+  return (it == chunks.end()) ? nullptr : it->owner;
+}
+
+}  // namespace mimium
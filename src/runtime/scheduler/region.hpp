@@ -0,0 +1,51 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/. */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mimium {
+// Closures created while a task is running are allocated from the region of
+// the task. A region is reference counted: the running task holds one, every
+// scheduled task whose closure lives in the region holds one, and a region
+// holds the region of the closure its task was called with, because new
+// closures may capture the old ones. When the count reaches zero the memory
+// is recycled at once, so temporal recursion keeps constant memory.
+class RegionAllocator {
+ public:
+  struct Region {
+    uint32_t refcount = 0;
+    Region* parent = nullptr;
+    char* pos = nullptr;
+    char* end = nullptr;
+  };
+  RegionAllocator();
+  ~RegionAllocator();
+  RegionAllocator(const RegionAllocator&) = delete;
+  RegionAllocator& operator=(const RegionAllocator&) = delete;
+
+  // parent may be nullptr
+  Region* create(Region* parent);
+  void retain(Region* region) { region->refcount++; }
+  void release(Region* region);
+  void* allocate(Region* region, size_t size);
+  // returns nullptr if the address is not in any region
+  Region* find(void* ptr) const;
+
+ private:
+  static constexpr size_t chunk_size = 4096;
+  static constexpr size_t alignment = 16;
+  struct Chunk {
+    char* begin;
+    char* end;
+    Region* owner;
+  };
+  std::vector<Chunk> chunks;  // chunks used by live regions
+  std::vector<char*> freechunks;
+  std::vector<Region*> freeregions;
+};
+
+}  // namespace mimium
@@ -4,6 +4,8 @@
 
 #include "runtime/scheduler/scheduler.hpp"
 
+#include <cstdlib>
+
 extern "C" {
 mimium::Scheduler* global_sch;
 
@@ -16,6 +18,13 @@ void setDspParams(void* dspfn,void* clsaddress, void* memobjaddress){
   global_sch->setDsp_MemobjAddress(memobjaddress);
 }
 
+void* mimium_pool_alloc(int64_t size) {
+  return global_sch->allocatePooledClosure(static_cast<size_t>(size));
+}
+void* mimium_region_alloc(int64_t size) {
+  return global_sch->allocateClosure(static_cast<size_t>(size));
+}
+
 void addTask(double time, void* addresstofn, double arg) {
   global_sch->addTask(time, addresstofn, arg, nullptr);
 }
@@ -41,18 +50,33 @@ bool Scheduler::incrementTime() {
     if (hastask && time > tasks.top().first) {
       executeTask(tasks.top().second);
     }
+    // closures made in this tick and not scheduled are no longer referred.
+    pool.collect();
   }
   return res;
 };
 void Scheduler::addTask(double time, void* addresstofn, double arg,
                         void* addresstocls) {
+  if (addresstocls != nullptr) {
+    if (auto* region = regions.find(addresstocls)) {
+      regions.retain(region);
+    } else if (pool.owns(addresstocls)) {
+      pool.retain(addresstocls);
+    }
+  }
   tasks.emplace(static_cast<int64_t>(time),
                 TaskType{addresstofn, arg, addresstocls});
 }
 
 void Scheduler::executeTask(const TaskType& task) {
-  // todo
-  auto& [addresstofn, arg, addresstocls] = task;
+  // copied and popped before the call because the task may add other tasks
+  // to the queue
+  auto [addresstofn, arg, addresstocls] = task;
+  tasks.pop();
+  RegionAllocator::Region* clsregion =
+      (addresstocls != nullptr) ? regions.find(addresstocls) : nullptr;
+  auto* prev_region = current_region;
+  current_region = regions.create(clsregion);
 
   if (addresstocls == nullptr) {
     auto fn = reinterpret_cast<void (*)(double)>(addresstofn);
@@ -61,7 +85,13 @@ void Scheduler::executeTask(const TaskType& task) {
     auto fn = reinterpret_cast<void (*)(double, void*)>(addresstofn);
     fn(arg, addresstocls);
   }
-  tasks.pop();
+  regions.release(current_region);
+  current_region = prev_region;
+  if (clsregion != nullptr) {
+    regions.release(clsregion);
+  } else if (addresstocls != nullptr && pool.owns(addresstocls)) {
+    pool.release(addresstocls);
+  }
   if (tasks.empty() && !runtime->hasDsp()) {
     stop();
   } else {
@@ -70,6 +100,18 @@ void Scheduler::executeTask(const TaskType& task) {
     }
   }
 }
+void* Scheduler::allocateClosure(size_t size) {
+  if (current_region != nullptr) {
+    return regions.allocate(current_region, size);
+  }
+  return std::malloc(size);
+}
+void* Scheduler::allocatePooledClosure(size_t size) {
+  if (current_region != nullptr) {
+    return regions.allocate(current_region, size);
+  }
+  return pool.allocate(size);
+}
 void Scheduler::haltRuntime(){
   isactive = false;
   {
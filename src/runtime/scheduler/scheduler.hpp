@@ -12,6 +12,8 @@
 #include "runtime/backend/audiodriver.hpp"
 
 #include "runtime/runtime.hpp"
+#include "runtime/scheduler/closure_pool.hpp"
+#include "runtime/scheduler/region.hpp"
 // #include "sndfile.h"
 
 namespace mimium {
@@ -51,6 +53,12 @@ class Scheduler {  // scheduler interface
 
   bool isactive = true;
   LLVMRuntime& getRuntime() { return *runtime; };
+  ClosurePool& getClosurePool() { return pool; }
+  // closures which may escape are taken from the region of the running task,
+  // or malloc outside of tasks.
+  void* allocateClosure(size_t size);
+  // closures passed only to tasks are also placed in the region inside tasks
+  void* allocatePooledClosure(size_t size);
   auto getTime() { return time; };
 
   void addAudioDriver(std::shared_ptr<AudioDriver> a);
@@ -71,6 +79,9 @@ class Scheduler {  // scheduler interface
       std::priority_queue<key_type, std::vector<key_type>, Greater>;
   int64_t time;
   queue_type tasks;
+  ClosurePool pool;
+  RegionAllocator regions;
+  RegionAllocator::Region* current_region = nullptr;
   virtual void executeTask(const TaskType& task);
 };
 